@@ -0,0 +1,462 @@
+#include "acquisition.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Merge a fresh reading into `current`, publish it and hand the reading to the pipeline
+static void acquisition_publish(struct acquisition_device *dev, struct sensors_sample *fresh, uint32_t channels)
+{
+    struct acquisition *acq = dev->worker->acq;
+
+    fresh->timestamp_ms = sensors_db_now_ms();
+    fresh->device = dev->config->id;
+
+    pthread_mutex_lock(&acq->lock);
+
+    if (dev->config->display)
+    {
+        struct sensor_snapshot snap = {0};
+
+        // Merged from several devices: no single id
+        acq->current.timestamp_ms = fresh->timestamp_ms;
+        acq->current.valid &= (uint16_t)~channels;
+        acq->current.valid |= fresh->valid;
+        for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+            if (fresh->valid & sensors_sample_channel_valid(ch))
+                acq->current.values[ch] = fresh->values[ch];
+        if (fresh->valid & SENSORS_SAMPLE_BMP280)
+        {
+            acq->current.bmp280_adc_T = fresh->bmp280_adc_T;
+            acq->current.bmp280_adc_P = fresh->bmp280_adc_P;
+        }
+        if (fresh->valid & SENSORS_SAMPLE_HTU21D_TEMP)
+            acq->current.htu21d_raw_temp = fresh->htu21d_raw_temp;
+        if (fresh->valid & SENSORS_SAMPLE_HTU21D_HUMIDITY)
+            acq->current.htu21d_raw_humidity = fresh->htu21d_raw_humidity;
+
+        snap.sample = acq->current;
+        clock_gettime(CLOCK_MONOTONIC, &snap.acquired);
+        sensor_snapshot_publish(acq->latest, &snap);
+    }
+
+    pipeline_submit(acq->pipeline, fresh, dev->config->display);
+
+    pthread_mutex_unlock(&acq->lock);
+}
+
+/****************** BMP280 ******************/
+
+// Conversion due: poll it, then read the raw ADC words, stored along with the compensated values
+static void bmp280_ready(struct event_source *src, uint32_t events)
+{
+    struct acquisition_device *dev = (struct acquisition_device *)src->arg;
+    struct sensors_sample sample = {0};
+
+    (void)events;
+
+    int ret = bmp280_poll_measurement(dev->bmp280);
+    if (ret == 1)
+    {
+        // Slower than the datasheet max: poll again a bit later, the other devices of the bus go on meanwhile
+        if (++dev->polls < BMP280_POLL_RETRIES && event_timer_arm_in(&dev->timer, BMP280_POLL_INTERVAL_NS, 0) == 0)
+            return;
+
+        fprintf(stderr, "BMP280 %s: measurement timed out\n", dev->config->name);
+    }
+
+    dev->busy = false;
+
+    if (ret == 0 && bmp280_read_result(dev->bmp280, &sample.bmp280_adc_T, &sample.bmp280_adc_P) == 0)
+    {
+        int32_t temp_centi;
+        uint32_t press_q8;
+
+        bmp280_compensate_batch(&dev->bmp280->calib, &sample.bmp280_adc_T, &sample.bmp280_adc_P, &temp_centi, &press_q8, 1);
+        sample.values[0] = temp_centi / 100.0f;
+        sample.values[1] = press_q8 / 25600.0f; // Q24.8 Pa to hPa
+        sample.valid |= SENSORS_SAMPLE_BMP280;
+    }
+
+    acquisition_publish(dev, &sample, SENSORS_SAMPLE_BMP280);
+
+    if (dev->worker->acq->verbose && (sample.valid & SENSORS_SAMPLE_BMP280))
+    {
+        printf("BMP280 %s temperature: %.2f °C\n", dev->config->name, sample.values[0]);
+        printf("BMP280 %s pressure: %.2f hPa\n", dev->config->name, sample.values[1]);
+    }
+}
+
+// Task: start one forced conversion, collected by bmp280_ready()
+static void bmp280_task(struct sched_task *task, const struct timespec *deadline)
+{
+    struct acquisition_device *dev = (struct acquisition_device *)task->arg;
+    struct timespec ready_at;
+
+    (void)deadline;
+
+    if (dev->busy)
+    {
+        dev->overruns++;
+        return;
+    }
+
+    if (bmp280_start_measurement(dev->bmp280, &ready_at) == 0 && event_timer_arm_at(&dev->timer, &ready_at, 0) == 0)
+    {
+        dev->busy = true;
+        dev->polls = 0;
+        return;
+    }
+
+    struct sensors_sample sample = {0};
+    acquisition_publish(dev, &sample, SENSORS_SAMPLE_BMP280);
+}
+
+/****************** HTU21D ******************/
+
+// Both conversions are over (successful or not): publish them
+static void htu21d_done(struct acquisition_device *dev)
+{
+    struct sensors_sample sample = {0};
+
+    dev->busy = false;
+
+    if (dev->temperature.is_valid)
+    {
+        sample.values[2] = dev->temperature.value;
+        sample.htu21d_raw_temp = dev->temperature.raw;
+        sample.valid |= SENSORS_SAMPLE_HTU21D_TEMP;
+    }
+
+    if (dev->humidity.is_valid)
+    {
+        sample.values[3] = dev->humidity.value;
+        sample.htu21d_raw_humidity = dev->humidity.raw;
+        sample.valid |= SENSORS_SAMPLE_HTU21D_HUMIDITY;
+    }
+
+    acquisition_publish(dev, &sample, SENSORS_SAMPLE_HTU21D_TEMP | SENSORS_SAMPLE_HTU21D_HUMIDITY);
+
+    if (!dev->worker->acq->verbose)
+        return;
+
+    if (dev->temperature.is_valid && dev->humidity.is_valid)
+    {
+        printf("HTU21D %s temperature: %.2f °C\n", dev->config->name, dev->temperature.value);
+        printf("HTU21D %s humidity: %.2f %%RH\n", dev->config->name, dev->humidity.value);
+    }
+    else
+    {
+        printf("Invalid HTU21D %s data: temp valid = %d, humidity valid = %d\n", dev->config->name,
+               dev->temperature.is_valid, dev->humidity.is_valid);
+    }
+}
+
+// Start a conversion and wake up when it should be done; false if it could not start
+static bool htu21d_start(struct acquisition_device *dev, enum htu21d_channel channel)
+{
+    struct timespec ready_at;
+
+    if (htu21d_start_conversion(dev->htu21d, channel, &ready_at) < 0)
+        return false;
+
+    if (event_timer_arm_at(&dev->timer, &ready_at, 0) < 0)
+    {
+        htu21d_cancel_conversion(dev->htu21d);
+        return false;
+    }
+
+    dev->htu21d_channel = channel;
+    dev->polls = 0;
+    return true;
+}
+
+// Conversion due: poll it, then go on with humidity after temperature
+static void htu21d_ready(struct event_source *src, uint32_t events)
+{
+    struct acquisition_device *dev = (struct acquisition_device *)src->arg;
+    struct htu21d_measurement res = {0};
+
+    (void)events;
+
+    int ret = htu21d_poll_conversion(dev->htu21d, &res);
+    if (ret == 1)
+    {
+        // Slower than the datasheet max: poll again a bit later
+        if (++dev->polls < HTU21D_POLL_RETRIES && event_timer_arm_in(&dev->timer, HTU21D_POLL_INTERVAL_NS, 0) == 0)
+            return;
+
+        fprintf(stderr, "HTU21D %s: conversion timed out\n", dev->config->name);
+        htu21d_cancel_conversion(dev->htu21d);
+    }
+
+    if (dev->htu21d_channel == HTU21D_TEMPERATURE)
+    {
+        dev->temperature = res;
+        if (htu21d_start(dev, HTU21D_HUMIDITY))
+            return;
+    }
+    else
+    {
+        dev->humidity = res;
+    }
+
+    htu21d_done(dev);
+}
+
+// Task: temperature then humidity conversion (about 50 ms + 16 ms), collected by htu21d_ready()
+static void htu21d_task(struct sched_task *task, const struct timespec *deadline)
+{
+    struct acquisition_device *dev = (struct acquisition_device *)task->arg;
+
+    (void)deadline;
+
+    if (dev->busy)
+    {
+        dev->overruns++;
+        return;
+    }
+
+    dev->temperature = (struct htu21d_measurement){0};
+    dev->humidity = (struct htu21d_measurement){0};
+
+    if (htu21d_start(dev, HTU21D_TEMPERATURE))
+        dev->busy = true;
+    else
+        htu21d_done(dev);
+}
+
+/****************** Workers ******************/
+
+// Verbose report: bus usage and scheduling statistics of one worker
+static void worker_status_task(struct sched_task *task, const struct timespec *deadline)
+{
+    struct acquisition_worker *worker = (struct acquisition_worker *)task->arg;
+    struct acquisition *acq = worker->acq;
+    struct i2c_stats stats;
+    uint64_t overruns = 0;
+
+    (void)deadline;
+
+    i2c_get_stats(worker->bus->i2c_bus, &stats);
+    printf("I2C %s: %llu transactions, %llu bytes in the last %lld s (display included)\n", worker->bus->path,
+           (unsigned long long)(stats.transactions - worker->i2c_last.transactions),
+           (unsigned long long)(stats.bytes - worker->i2c_last.bytes), (long long)(task->period_ns / 1000000000LL));
+    worker->i2c_last = stats;
+
+    for (size_t i = 0; i < acq->device_count; i++)
+        if (acq->devices[i].worker == worker)
+            overruns += acq->devices[i].overruns;
+
+    printf("Worker %s: %llu wakeups, %llu callbacks, %llu sensor overruns\n", worker->bus->path,
+           (unsigned long long)worker->loop.waits, (unsigned long long)worker->loop.dispatched,
+           (unsigned long long)overruns);
+
+    for (size_t i = 0; i < worker->sched.count; i++)
+    {
+        const struct sched_task *t = worker->sched.heap[i];
+        printf("Task %s: %llu runs, %llu missed deadlines, max %.3f ms late\n", t->name, (unsigned long long)t->runs,
+               (unsigned long long)t->missed, t->max_late_ns / 1e6);
+    }
+}
+
+static void worker_stop_event(struct event_source *src, uint32_t events)
+{
+    struct acquisition_worker *worker = (struct acquisition_worker *)src->arg;
+
+    (void)events;
+
+    event_loop_stop(&worker->loop);
+}
+
+static void *worker_thread(void *arg)
+{
+    struct acquisition_worker *worker = (struct acquisition_worker *)arg;
+
+    event_loop_run(&worker->loop);
+
+    return NULL;
+}
+
+// Loop, scheduler and stop wakeup of one bus, `tasks` devices plus the status task
+static int worker_init(struct acquisition_worker *worker, struct acquisition *acq, const struct device_registry_bus *bus,
+                       size_t tasks)
+{
+    worker->acq = acq;
+    worker->bus = bus;
+    worker->stop = (struct event_source){.cb = worker_stop_event, .arg = worker};
+
+    if (event_loop_init(&worker->loop) < 0)
+        return -1;
+
+    if (scheduler_init(&worker->sched, tasks + 1) < 0 || scheduler_attach(&worker->sched, &worker->loop) < 0 ||
+        event_loop_add_wakeup(&worker->loop, &worker->stop) < 0)
+        return -1;
+
+    return 0;
+}
+
+static void worker_destroy(struct acquisition_worker *worker)
+{
+    if (!worker->acq)
+        return;
+
+    scheduler_destroy(&worker->sched);
+    event_loop_remove(&worker->loop, &worker->stop);
+    event_loop_destroy(&worker->loop);
+}
+
+// Driver, timer and scheduler task of one sensor (the display is not acquisition's)
+static int device_init(struct acquisition_device *dev, struct acquisition_worker *worker, const struct device_config *config,
+                       int64_t delay_ns)
+{
+    int64_t offset_ns = delay_ns;
+
+    dev->worker = worker;
+    dev->config = config;
+    dev->task = (struct sched_task){.name = config->name, .arg = dev, .period_ns = config->period_ns};
+    dev->timer = (struct event_source){.arg = dev};
+
+    switch (config->driver)
+    {
+    case DEVICE_DRIVER_BMP280:
+        dev->bmp280 = bmp280_init(config->i2c_bus, config->address);
+        if (!dev->bmp280)
+        {
+            fprintf(stderr, "BMP280 %s: no answer at 0x%02x\n", config->name, config->address);
+            return -1;
+        }
+        dev->task.fn = bmp280_task;
+        dev->timer.cb = bmp280_ready;
+        if (dev->task.period_ns == 0)
+            dev->task.period_ns = BMP280_PERIOD_NS;
+        break;
+
+    case DEVICE_DRIVER_HTU21D:
+        dev->htu21d = htu21d_init(config->i2c_bus, config->address);
+        if (!dev->htu21d)
+        {
+            fprintf(stderr, "HTU21D %s: no answer at 0x%02x\n", config->name, config->address);
+            return -1;
+        }
+        if (htu21d_end_of_battery(dev->htu21d) == 1)
+            fprintf(stderr, "HTU21D %s: supply voltage below 2.25V, readings may be off\n", config->name);
+        dev->task.fn = htu21d_task;
+        dev->timer.cb = htu21d_ready;
+        if (dev->task.period_ns == 0)
+            dev->task.period_ns = HTU21D_PERIOD_NS;
+        offset_ns += HTU21D_OFFSET_NS;
+        break;
+
+    default:
+        return -1;
+    }
+
+    if (event_loop_add_timer(&worker->loop, &dev->timer) < 0)
+        return -1;
+
+    return scheduler_add(&worker->sched, &dev->task, offset_ns);
+}
+
+/****************** Public API ******************/
+
+struct acquisition *acquisition_start(const struct device_registry *registry, struct pipeline *pipeline,
+                                      struct sensor_snapshot_cell *latest, int64_t delay_ns, int verbose)
+{
+    if (!registry || !pipeline || !latest)
+        return NULL;
+
+    struct acquisition *acq = (struct acquisition *)calloc(1, sizeof(struct acquisition));
+    if (!acq)
+        return NULL;
+
+    acq->pipeline = pipeline;
+    acq->latest = latest;
+    acq->verbose = verbose;
+    pthread_mutex_init(&acq->lock, NULL);
+
+    for (size_t b = 0; b < registry->bus_count; b++)
+    {
+        struct acquisition_worker *worker = &acq->workers[acq->worker_count];
+        size_t tasks = 0;
+
+        for (size_t i = 0; i < registry->count; i++)
+            if (registry->devices[i].bus_index == (int)b && registry->devices[i].driver != DEVICE_DRIVER_LCD1602)
+                tasks++;
+
+        if (tasks == 0)
+            continue; // display only
+
+        acq->worker_count++;
+        if (worker_init(worker, acq, &registry->buses[b], tasks) < 0)
+            goto err_stop;
+
+        for (size_t i = 0; i < registry->count; i++)
+        {
+            const struct device_config *config = &registry->devices[i];
+
+            if (config->bus_index != (int)b || config->driver == DEVICE_DRIVER_LCD1602)
+                continue;
+
+            if (device_init(&acq->devices[acq->device_count++], worker, config, delay_ns) < 0)
+            {
+                fprintf(stderr, "Failed to set up device %u (%s)\n", (unsigned)config->id, config->name);
+                goto err_stop;
+            }
+        }
+
+        if (verbose)
+        {
+            worker->status = (struct sched_task){
+                .name = "status", .fn = worker_status_task, .arg = worker, .period_ns = ACQUISITION_STATUS_PERIOD_NS};
+            i2c_get_stats(worker->bus->i2c_bus, &worker->i2c_last);
+            if (scheduler_add(&worker->sched, &worker->status, delay_ns + ACQUISITION_STATUS_PERIOD_NS) < 0)
+                goto err_stop;
+        }
+    }
+
+    for (size_t w = 0; w < acq->worker_count; w++)
+    {
+        if (pthread_create(&acq->workers[w].thread, NULL, worker_thread, &acq->workers[w]) != 0)
+        {
+            perror("Failed to start an acquisition worker");
+            goto err_stop;
+        }
+        acq->workers[w].started = true;
+    }
+
+    return acq;
+
+err_stop:
+    acquisition_stop(acq);
+    return NULL;
+}
+
+void acquisition_stop(struct acquisition *self)
+{
+    if (!self)
+        return;
+
+    for (size_t w = 0; w < self->worker_count; w++)
+        if (self->workers[w].started)
+            event_wakeup(&self->workers[w].stop);
+
+    for (size_t w = 0; w < self->worker_count; w++)
+        if (self->workers[w].started)
+            pthread_join(self->workers[w].thread, NULL);
+
+    for (size_t i = 0; i < self->device_count; i++)
+    {
+        struct acquisition_device *dev = &self->devices[i];
+
+        if (dev->timer.loop)
+            event_loop_remove(dev->timer.loop, &dev->timer);
+        bmp280_close(dev->bmp280);
+        htu21d_close(dev->htu21d);
+    }
+
+    for (size_t w = 0; w < self->worker_count; w++)
+        worker_destroy(&self->workers[w]);
+
+    pthread_mutex_destroy(&self->lock);
+    free(self);
+}
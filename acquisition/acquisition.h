@@ -0,0 +1,107 @@
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+
+/*
+    Sensor acquisition, one worker thread per physical I2C bus. Each worker
+    runs its own event loop and scheduler for the sensors of its bus (mux
+    channels included), so a slow or stuck bus only delays its own
+    devices. A conversion is started by the sensor's scheduler task and
+    collected by its timer callback once it should be done: no worker ever
+    sleeps on a sensor.
+
+    Every reading is tagged with the registry id of its device and handed
+    to the pipeline; `current` merges the latest reading of every channel
+    (devices with display=no left out) into the snapshot the display
+    reads. The workers serialize that merge, the snapshot publication and
+    the pipeline submission (single writer, single producer) with `lock`.
+*/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include "bmp280.h"
+#include "htu21d.h"
+#include "event_loop.h"
+#include "scheduler.h"
+#include "pipeline.h"
+#include "sensor_snapshot.h"
+#include "device_registry.h"
+
+// Default sampling periods (absolute deadlines, see scheduler.h); `period=` overrides them
+#define BMP280_PERIOD_NS (1000LL * 1000 * 1000)        // pressure at 1 Hz
+#define HTU21D_PERIOD_NS (10 * 1000LL * 1000 * 1000)   // temperature/humidity every 10 s
+#define HTU21D_OFFSET_NS (500LL * 1000 * 1000)         // between two BMP280 reads
+#define ACQUISITION_STATUS_PERIOD_NS (10 * 1000LL * 1000 * 1000) // verbose report
+
+// HTU21D still NACKing at its datasheet max conversion time: poll again this often
+#define HTU21D_POLL_INTERVAL_NS (1000LL * 1000)
+#define HTU21D_POLL_RETRIES 20
+
+// BMP280 still `measuring` at its datasheet max time: read the status again this often
+#define BMP280_POLL_INTERVAL_NS (500LL * 1000)
+#define BMP280_POLL_RETRIES 20
+
+struct acquisition_worker;
+
+struct acquisition_device
+{
+    struct acquisition_worker *worker;
+    const struct device_config *config;
+    struct bmp280 *bmp280;
+    struct htu21d *htu21d;
+
+    struct sched_task task;
+    struct event_source timer; // conversion done, or next poll
+    bool busy;
+    int polls;         // status polls of the running conversion past its expected end
+    uint64_t overruns; // deadlines hit while the previous conversion was still running
+
+    // HTU21D: temperature then humidity
+    enum htu21d_channel htu21d_channel;
+    struct htu21d_measurement temperature, humidity;
+};
+
+struct acquisition_worker
+{
+    struct acquisition *acq;
+    const struct device_registry_bus *bus;
+
+    struct event_loop loop;
+    struct scheduler sched;
+    struct event_source stop; // wakeup: leave the loop
+    struct sched_task status;
+    struct i2c_stats i2c_last; // status task
+
+    pthread_t thread;
+    bool started;
+};
+
+struct acquisition
+{
+    struct pipeline *pipeline;
+    struct sensor_snapshot_cell *latest;
+    int verbose;
+
+    pthread_mutex_t lock; // current, snapshot publication and pipeline_submit()
+    struct sensors_sample current;
+
+    struct acquisition_device devices[DEVICE_REGISTRY_MAX_DEVICES];
+    size_t device_count;
+
+    struct acquisition_worker workers[DEVICE_REGISTRY_MAX_BUSES];
+    size_t worker_count;
+};
+
+/*
+    Set up the sensors of `registry` (already opened, see
+    device_registry_open()) and start one worker per bus; the first
+    deadlines are `delay_ns` from now. Call it after the signals are
+    routed to the main loop, so the workers inherit the blocked mask.
+    Returns NULL on failure.
+*/
+struct acquisition *acquisition_start(const struct device_registry *registry, struct pipeline *pipeline,
+                                      struct sensor_snapshot_cell *latest, int64_t delay_ns, int verbose);
+
+// Stop and join the workers, then close the sensors (a conversion still running is just abandoned)
+void acquisition_stop(struct acquisition *self);
+
+#endif /* ACQUISITION_H */
@@ -1,33 +1,27 @@
 #include "bmp280.h"
 #include <stdint.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
 #include "i2c.h"
 #include "stdlib.h"
 
-#define BMP280_ADDR 0x76
-
 // BMP280 registers
-#define REG_CALIB 0x88
+#define REG_CALIB BMP280_REG_CALIB
+#define REG_STATUS 0xF3
 #define REG_CTRL_MEAS 0xF4
 #define REG_CONFIG 0xF5
-#define REG_PRESS_MSB 0xF7
+#define REG_PRESS_MSB BMP280_REG_DATA
 #define REG_TEMP_MSB 0xF7
 
-// Function to read and parse BMP280 calibration data
-static int
-bmp280_read_calibration(struct I2cBus *i2c_bus, bmp280_calib_data *calib)
-{
-    if (i2c_bus == NULL || calib == NULL)
-    {
-        return -1;
-    }
+#define STATUS_MEASURING 0x08
 
-    uint8_t calib_data[24];
-    if (i2c_read_register(i2c_bus, BMP280_ADDR, REG_CALIB, calib_data, 24) < 0)
-    {
-        return -1;
-    }
+// Polling once the expected measurement time has elapsed
+#define BMP280_POLL_INTERVAL_US 500
+#define BMP280_POLL_RETRIES 20
 
+void bmp280_parse_calibration(const uint8_t calib_data[BMP280_CALIB_SIZE], bmp280_calib_data *calib)
+{
     calib->dig_T1 = (calib_data[1] << 8) | calib_data[0];
     calib->dig_T2 = (calib_data[3] << 8) | calib_data[2];
     calib->dig_T3 = (calib_data[5] << 8) | calib_data[4];
@@ -40,11 +34,99 @@ bmp280_read_calibration(struct I2cBus *i2c_bus, bmp280_calib_data *calib)
     calib->dig_P7 = (calib_data[19] << 8) | calib_data[18];
     calib->dig_P8 = (calib_data[21] << 8) | calib_data[20];
     calib->dig_P9 = (calib_data[23] << 8) | calib_data[22];
+}
+
+void bmp280_parse_raw(const uint8_t data[BMP280_DATA_SIZE], int32_t *adc_T, int32_t *adc_P)
+{
+    *adc_P = ((int32_t)data[0] << 12) | ((int32_t)data[1] << 4) | ((int32_t)data[2] >> 4);
+    *adc_T = ((int32_t)data[3] << 12) | ((int32_t)data[4] << 4) | ((int32_t)data[5] >> 4);
+}
+
+// Function to read and parse BMP280 calibration data
+static int
+bmp280_read_calibration(struct I2cBus *i2c_bus, uint8_t addr, bmp280_calib_data *calib)
+{
+    if (i2c_bus == NULL || calib == NULL)
+    {
+        return -1;
+    }
+
+    uint8_t calib_data[BMP280_CALIB_SIZE];
+    // Burst read of the whole calibration block in one combined transaction
+    if (i2c_read_register(i2c_bus, addr, REG_CALIB, calib_data, BMP280_CALIB_SIZE) < 0)
+    {
+        return -1;
+    }
+
+    bmp280_parse_calibration(calib_data, calib);
 
     return 0;
 }
 
-struct bmp280 *bmp280_init(struct I2cBus *i2c_bus)
+struct bmp280_config bmp280_preset(enum bmp280_preset preset)
+{
+    switch (preset)
+    {
+    case BMP280_PRESET_HANDHELD_LOW_POWER:
+        return (struct bmp280_config){BMP280_OS_X2, BMP280_OS_X16, BMP280_FILTER_X4, BMP280_STANDBY_62_5_MS, BMP280_MODE_NORMAL};
+    case BMP280_PRESET_HANDHELD_DYNAMIC:
+        return (struct bmp280_config){BMP280_OS_X1, BMP280_OS_X4, BMP280_FILTER_X16, BMP280_STANDBY_0_5_MS, BMP280_MODE_NORMAL};
+    case BMP280_PRESET_INDOOR_NAVIGATION:
+        return (struct bmp280_config){BMP280_OS_X2, BMP280_OS_X16, BMP280_FILTER_X16, BMP280_STANDBY_0_5_MS, BMP280_MODE_NORMAL};
+    case BMP280_PRESET_WEATHER_MONITORING:
+    default:
+        return (struct bmp280_config){BMP280_OS_X1, BMP280_OS_X1, BMP280_FILTER_OFF, BMP280_STANDBY_0_5_MS, BMP280_MODE_FORCED};
+    }
+}
+
+// Datasheet section 3.8.1: t_meas,max = 1.25 + 2.3 * T_os + (2.3 * P_os + 0.575) ms
+uint32_t bmp280_measurement_time_us(const struct bmp280_config *config)
+{
+    uint32_t t_os = config->osrs_t ? 1u << (config->osrs_t - 1) : 0;
+    uint32_t p_os = config->osrs_p ? 1u << (config->osrs_p - 1) : 0;
+
+    uint32_t us = 1250 + 2300 * t_os;
+    if (p_os)
+        us += 2300 * p_os + 575;
+
+    return us;
+}
+
+static uint8_t bmp280_ctrl_meas(const struct bmp280_config *config, enum bmp280_mode mode)
+{
+    return (config->osrs_t << 5) | (config->osrs_p << 2) | mode;
+}
+
+int bmp280_configure(struct bmp280 *self, const struct bmp280_config *config)
+{
+    if (!self || !self->i2c_bus || !config)
+        return -1;
+
+    /*
+        config writes may be ignored in normal mode: go to sleep first, then
+        set config and ctrl_meas. All (register, value) pairs in one write.
+        Forced mode is entered per measurement, the sensor stays asleep here.
+    */
+    enum bmp280_mode mode = (config->mode == BMP280_MODE_NORMAL) ? BMP280_MODE_NORMAL : BMP280_MODE_SLEEP;
+    uint8_t regs[6] = {
+        REG_CTRL_MEAS, bmp280_ctrl_meas(config, BMP280_MODE_SLEEP),
+        REG_CONFIG, (config->standby << 5) | (config->filter << 2),
+        REG_CTRL_MEAS, bmp280_ctrl_meas(config, mode)};
+
+    if (i2c_write(self->i2c_bus, self->addr, regs, sizeof(regs)) != 0)
+    {
+        perror("Failed to configure BMP280");
+        return -1;
+    }
+
+    self->config = *config;
+    self->meas_time_us = bmp280_measurement_time_us(config);
+    self->measuring = false;
+
+    return 0;
+}
+
+struct bmp280 *bmp280_init(struct I2cBus *i2c_bus, uint8_t addr)
 {
     if (!i2c_bus)
     {
@@ -59,16 +141,18 @@ struct bmp280 *bmp280_init(struct I2cBus *i2c_bus)
     }
 
     sens->i2c_bus = i2c_bus;
+    sens->addr = addr;
 
-    if (bmp280_read_calibration(i2c_bus, &sens->calib) < 0)
+    if (bmp280_read_calibration(i2c_bus, addr, &sens->calib) < 0)
     {
         goto err_free;
     }
 
-    // Configure BMP280: Normal mode, temperature + pressure, oversampling x1, and standby time 0.5ms
-    if (i2c_write_register(i2c_bus, BMP280_ADDR, REG_CTRL_MEAS, 0x27) != 0)
+    // Sampled every few seconds: forced mode, the sensor sleeps between samples
+    struct bmp280_config config = bmp280_preset(BMP280_PRESET_WEATHER_MONITORING);
+
+    if (bmp280_configure(sens, &config) != 0)
     {
-        perror("Failed to configure BMP280");
         goto err_free;
     }
 
@@ -80,6 +164,114 @@ err_exit:
     return NULL;
 }
 
+int bmp280_start_measurement(struct bmp280 *self, struct timespec *ready_at)
+{
+    if (!self || !self->i2c_bus)
+        return -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &self->ready_at);
+
+    if (self->config.mode == BMP280_MODE_FORCED)
+    {
+        if (i2c_write_register(self->i2c_bus, self->addr, REG_CTRL_MEAS, bmp280_ctrl_meas(&self->config, BMP280_MODE_FORCED)) != 0)
+            return -1;
+
+        self->measuring = true;
+
+        self->ready_at.tv_nsec += (long)self->meas_time_us * 1000;
+        self->ready_at.tv_sec += self->ready_at.tv_nsec / 1000000000;
+        self->ready_at.tv_nsec %= 1000000000;
+    }
+
+    if (ready_at)
+        *ready_at = self->ready_at;
+
+    return 0;
+}
+
+int bmp280_poll_measurement(struct bmp280 *self)
+{
+    uint8_t status;
+
+    if (!self || !self->i2c_bus)
+        return -1;
+
+    if (!self->measuring)
+        return 0;
+
+    if (i2c_read_register(self->i2c_bus, self->addr, REG_STATUS, &status, 1) != 0)
+        return -1;
+
+    if (status & STATUS_MEASURING)
+        return 1;
+
+    self->measuring = false;
+    return 0;
+}
+
+// Wait for the running forced conversion: sleep until its deadline, then poll `measuring`
+static int bmp280_wait_measurement(struct bmp280 *self)
+{
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &self->ready_at, NULL) == EINTR)
+        ;
+
+    for (int retry = 0; retry < BMP280_POLL_RETRIES; retry++)
+    {
+        int ret = bmp280_poll_measurement(self);
+
+        if (ret <= 0)
+            return ret;
+
+        usleep(BMP280_POLL_INTERVAL_US);
+    }
+
+    fprintf(stderr, "BMP280: measurement timed out\n");
+    self->measuring = false;
+    return -1;
+}
+
+int bmp280_read_raw(struct bmp280 *self, int32_t *adc_T, int32_t *adc_P)
+{
+    if (self == NULL || self->i2c_bus == NULL || adc_T == NULL || adc_P == NULL)
+    {
+        return -1;
+    }
+
+    if (self->config.mode == BMP280_MODE_FORCED)
+    {
+        if (!self->measuring && bmp280_start_measurement(self, NULL) != 0)
+            return -1;
+
+        // Only read once the conversion is complete, never a half-updated result
+        if (bmp280_wait_measurement(self) != 0)
+            return -1;
+    }
+
+    return bmp280_read_result(self, adc_T, adc_P);
+}
+
+int bmp280_read_result(struct bmp280 *self, int32_t *adc_T, int32_t *adc_P)
+{
+    if (self == NULL || self->i2c_bus == NULL || adc_T == NULL || adc_P == NULL)
+    {
+        return -1;
+    }
+
+    uint8_t data[BMP280_DATA_SIZE];
+
+    // Read 6 bytes: 3 bytes for pressure and 3 bytes for temperature
+    // (register write + burst read with repeated-start, so the data registers are read as one shadowed block)
+    if (i2c_read_register(self->i2c_bus, self->addr, REG_PRESS_MSB, data, BMP280_DATA_SIZE) != 0)
+    {
+        return -1;
+    }
+
+    // Extract raw ADC values from data array
+    bmp280_parse_raw(data, adc_T, adc_P);
+
+    return 0;
+}
+
 // Function to calculate temperature and pressure using the calibration parameters
 int bmp280_get_measurement(struct bmp280 *self,
                            float *temperature, float *pressure)
@@ -89,52 +281,22 @@ int bmp280_get_measurement(struct bmp280 *self,
         return -1;
     }
 
-    uint8_t data[6];
+    int32_t adc_T, adc_P;
 
-    // Read 6 bytes: 3 bytes for pressure and 3 bytes for temperature
-    if (i2c_read_register(self->i2c_bus, BMP280_ADDR, REG_PRESS_MSB, data, 6) != 0)
+    if (bmp280_read_raw(self, &adc_T, &adc_P) != 0)
     {
         *temperature = 0;
         *pressure = 0;
         return -1;
     }
 
-    // Extract raw ADC values from data array
-    int32_t adc_P = ((int32_t)data[0] << 12) | ((int32_t)data[1] << 4) | ((int32_t)data[2] >> 4);
-    int32_t adc_T = ((int32_t)data[3] << 12) | ((int32_t)data[4] << 4) | ((int32_t)data[5] >> 4);
-
-    // Temperature calculations (from BMP280 datasheet)
-    int32_t var1, var2, t_fine;
-
-    var1 = ((((adc_T >> 3) - ((int32_t)self->calib.dig_T1 << 1))) * ((int32_t)self->calib.dig_T2)) >> 11;
-    var2 = (((((adc_T >> 4) - ((int32_t)self->calib.dig_T1)) * ((adc_T >> 4) - ((int32_t)self->calib.dig_T1))) >> 12) *
-            ((int32_t)self->calib.dig_T3)) >>
-           14;
-    t_fine = var1 + var2;
-    *temperature = (t_fine * 5 + 128) >> 8;
-    *temperature /= 100.0; // Convert to °C
-
-    // Pressure calculations (from BMP280 datasheet)
-    var1 = (((int32_t)t_fine) >> 1) - (int32_t)64000;
-    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11) * ((int32_t)self->calib.dig_P6);
-    var2 = var2 + ((var1 * ((int32_t)self->calib.dig_P5)) << 1);
-    var2 = (var2 >> 2) + (((int32_t)self->calib.dig_P4) << 16);
-    var1 = (((self->calib.dig_P3 * (((var1 >> 2) * (var1 >> 2)) >> 13)) >> 3) + ((((int32_t)self->calib.dig_P2) * var1) >> 1)) >> 18;
-    var1 = ((((32768 + var1)) * ((int32_t)self->calib.dig_P1)) >> 15);
-
-    if (var1 == 0)
-    {
-        *pressure = 0; // Avoid division by zero
-        return 0;
-    }
+    int32_t temp_centi;
+    uint32_t press_q8;
 
-    int32_t p = (((uint32_t)(((int32_t)1048576) - adc_P) - (var2 >> 12))) * 3125;
-    p = (p < (int32_t)0x80000000) ? (p << 1) / ((uint32_t)var1) : (p / (uint32_t)var1) * 2;
-    var1 = (((int32_t)self->calib.dig_P9) * ((int32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
-    var2 = (((int32_t)(p >> 2)) * ((int32_t)self->calib.dig_P8)) >> 13;
-    p = (int32_t)((int32_t)p + ((var1 + var2 + self->calib.dig_P7) >> 4));
+    bmp280_compensate_batch(&self->calib, &adc_T, &adc_P, &temp_centi, &press_q8, 1);
 
-    *pressure = p / 100.0; // Convert to hPa
+    *temperature = temp_centi / 100.0f;  // Convert to °C
+    *pressure = press_q8 / 25600.0f;     // Q24.8 Pa to hPa
 
     return 0;
 }
@@ -1,8 +1,19 @@
 #ifndef BMP280_H
 #define BMP280_H
 
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
 #include "i2c.h"
 
+#define BMP280_DEFAULT_ADDR 0x76 // SDO to GND, 0x77 with SDO to VDDIO
+
+// Register blocks read in one burst, decoded by bmp280_parse_*()
+#define BMP280_REG_CALIB 0x88
+#define BMP280_CALIB_SIZE 24
+#define BMP280_REG_DATA 0xF7 // press_msb .. temp_xlsb
+#define BMP280_DATA_SIZE 6
+
 // Calibration parameters structure
 typedef struct
 {
@@ -12,18 +23,131 @@ typedef struct
     int16_t dig_P2, dig_P3, dig_P4, dig_P5, dig_P6, dig_P7, dig_P8, dig_P9;
 } bmp280_calib_data;
 
+/* Oversampling (osrs_t / osrs_p in ctrl_meas) */
+enum bmp280_oversampling
+{
+    BMP280_OS_SKIP = 0,
+    BMP280_OS_X1,
+    BMP280_OS_X2,
+    BMP280_OS_X4,
+    BMP280_OS_X8,
+    BMP280_OS_X16,
+};
+
+/* IIR filter coefficient (filter in config) */
+enum bmp280_filter
+{
+    BMP280_FILTER_OFF = 0,
+    BMP280_FILTER_X2,
+    BMP280_FILTER_X4,
+    BMP280_FILTER_X8,
+    BMP280_FILTER_X16,
+};
+
+/* Standby time between two conversions in normal mode (t_sb in config) */
+enum bmp280_standby
+{
+    BMP280_STANDBY_0_5_MS = 0,
+    BMP280_STANDBY_62_5_MS,
+    BMP280_STANDBY_125_MS,
+    BMP280_STANDBY_250_MS,
+    BMP280_STANDBY_500_MS,
+    BMP280_STANDBY_1000_MS,
+    BMP280_STANDBY_2000_MS,
+    BMP280_STANDBY_4000_MS,
+};
+
+enum bmp280_mode
+{
+    BMP280_MODE_SLEEP = 0,
+    BMP280_MODE_FORCED = 1, // one conversion per bmp280_start_measurement(), then back to sleep
+    BMP280_MODE_NORMAL = 3, // free running
+};
+
+struct bmp280_config
+{
+    enum bmp280_oversampling osrs_t;
+    enum bmp280_oversampling osrs_p;
+    enum bmp280_filter filter;
+    enum bmp280_standby standby;
+    enum bmp280_mode mode;
+};
+
+/* Recommended settings (datasheet section 3.4) */
+enum bmp280_preset
+{
+    BMP280_PRESET_WEATHER_MONITORING, // forced, T x1, P x1, filter off
+    BMP280_PRESET_HANDHELD_LOW_POWER, // normal, T x2, P x16, filter x4, 62.5 ms standby
+    BMP280_PRESET_HANDHELD_DYNAMIC,   // normal, T x1, P x4, filter x16, 0.5 ms standby
+    BMP280_PRESET_INDOOR_NAVIGATION,  // normal, T x2, P x16, filter x16, 0.5 ms standby
+};
+
 struct bmp280
 {
     bmp280_calib_data calib;
     struct I2cBus *i2c_bus;
+    uint8_t addr;
+
+    struct bmp280_config config;
+    uint32_t meas_time_us; // max conversion time for `config`
+
+    /* Forced conversion in progress */
+    bool measuring;
+    struct timespec ready_at; // CLOCK_MONOTONIC
 };
 
-struct bmp280 *bmp280_init(struct I2cBus *i2c_bus);
+/* Sensor at `addr` on `i2c_bus`, starts with BMP280_PRESET_WEATHER_MONITORING (forced mode) */
+struct bmp280 *bmp280_init(struct I2cBus *i2c_bus, uint8_t addr);
 
-// Function to calculate temperature and pressure using the calibration parameters
+struct bmp280_config bmp280_preset(enum bmp280_preset preset);
+int bmp280_configure(struct bmp280 *self, const struct bmp280_config *config);
+
+// Datasheet max measurement time for a configuration
+uint32_t bmp280_measurement_time_us(const struct bmp280_config *config);
+
+/*
+    Forced mode acquisition:
+    - bmp280_start_measurement() triggers one conversion, `ready_at`
+      (CLOCK_MONOTONIC, may be NULL) is when it should be done
+    - bmp280_poll_measurement() returns 1 while the status `measuring` bit
+      is set, 0 once results are available, -1 on error
+    In normal mode start is a no-op and results are always available.
+*/
+int bmp280_start_measurement(struct bmp280 *self, struct timespec *ready_at);
+int bmp280_poll_measurement(struct bmp280 *self);
+
+/*
+    Function to calculate temperature and pressure using the calibration parameters.
+    In forced mode, waits for the conversion started by bmp280_start_measurement()
+    (or starts one if none is running).
+*/
 int bmp280_get_measurement(struct bmp280 *self,
                            float *temperature, float *pressure);
 
+// Raw 20-bit ADC values (same wait/poll as bmp280_get_measurement), for storing and compensating later
+int bmp280_read_raw(struct bmp280 *self, int32_t *adc_T, int32_t *adc_P);
+
+// Raw ADC values as the data registers hold them, never waits: once bmp280_poll_measurement() returned 0
+int bmp280_read_result(struct bmp280 *self, int32_t *adc_T, int32_t *adc_P);
+
+/*
+    Decode register blocks as read from the bus (pure, for captured
+    transactions too): the calibration words, and the 20-bit ADC values.
+*/
+void bmp280_parse_calibration(const uint8_t data[BMP280_CALIB_SIZE], bmp280_calib_data *calib);
+void bmp280_parse_raw(const uint8_t data[BMP280_DATA_SIZE], int32_t *adc_T, int32_t *adc_P);
+
+/*
+    Batch compensation of raw samples (struct-of-arrays, n entries each),
+    datasheet integer formulas with the 64-bit pressure path:
+    - temp_centi: temperature in 0.01 °C
+    - press_q8: pressure in Pa as unsigned Q24.8 (divide by 256 for Pa), 0 if invalid
+    Pure computation, no bus access: suitable for backfill and replay.
+*/
+void bmp280_compensate_batch(const bmp280_calib_data *calib,
+                             const int32_t *adc_T, const int32_t *adc_P,
+                             int32_t *temp_centi, uint32_t *press_q8, size_t n);
+
 void bmp280_close(struct bmp280 *self);
 
 #endif /* BMP280_H */
@@ -0,0 +1,92 @@
+/*
+ * BMP280 compensation kernel (datasheet section 3.11.3 / 8.2)
+ *
+ * Works on arrays of raw samples so a year of stored adc_T/adc_P can be
+ * reprocessed in one call. The loops are kept branch-free and laid out
+ * struct-of-arrays so GCC can auto-vectorize them (NEON on aarch64):
+ * - temperature/t_fine is pure 32-bit arithmetic and vectorizes fully
+ * - pressure uses the 64-bit path, its per-sample 64-bit division keeps
+ *   that loop scalar, but it is still free of branches and calls
+ */
+
+#include "bmp280.h"
+#include <stdint.h>
+
+// Samples processed per block (t_fine scratch stays in L1)
+#define COMPENSATE_BLOCK 256
+
+static void bmp280_compensate_temperature(const bmp280_calib_data *calib,
+                                          const int32_t *restrict adc_T,
+                                          int32_t *restrict t_fine,
+                                          int32_t *restrict temp_centi, size_t n)
+{
+    const int32_t T1 = calib->dig_T1;
+    const int32_t T2 = calib->dig_T2;
+    const int32_t T3 = calib->dig_T3;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        int32_t var1 = (((adc_T[i] >> 3) - (T1 * 2)) * T2) >> 11;
+        int32_t d = (adc_T[i] >> 4) - T1;
+        int32_t var2 = (((d * d) >> 12) * T3) >> 14;
+
+        t_fine[i] = var1 + var2;
+        temp_centi[i] = (t_fine[i] * 5 + 128) >> 8;
+    }
+}
+
+static void bmp280_compensate_pressure(const bmp280_calib_data *calib,
+                                       const int32_t *restrict adc_P,
+                                       const int32_t *restrict t_fine,
+                                       uint32_t *restrict press_q8, size_t n)
+{
+    const int64_t P1 = calib->dig_P1;
+    const int64_t P2 = calib->dig_P2;
+    const int64_t P3 = calib->dig_P3;
+    const int64_t P4 = calib->dig_P4;
+    const int64_t P5 = calib->dig_P5;
+    const int64_t P6 = calib->dig_P6;
+    const int64_t P7 = calib->dig_P7;
+    const int64_t P8 = calib->dig_P8;
+    const int64_t P9 = calib->dig_P9;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        // Shifts of signed values written as multiplications (same result, no UB)
+        int64_t var1 = (int64_t)t_fine[i] - 128000;
+        int64_t var2 = var1 * var1 * P6;
+        var2 = var2 + var1 * P5 * (1LL << 17);
+        var2 = var2 + P4 * (1LL << 35);
+        var1 = ((var1 * var1 * P3) >> 8) + var1 * P2 * (1LL << 12);
+        var1 = (((1LL << 47) + var1) * P1) >> 33;
+
+        // var1 == 0 only with a bogus calibration: report 0 instead of dividing by zero
+        int64_t valid = var1 != 0;
+        int64_t div = valid ? var1 : 1;
+        int64_t p = 1048576 - adc_P[i];
+        p = ((p * (1LL << 31) - var2) * 3125) / div;
+        var1 = (P9 * (p >> 13) * (p >> 13)) >> 25;
+        var2 = (P8 * p) >> 19;
+        p = ((p + var1 + var2) >> 8) + P7 * 16;
+
+        press_q8[i] = valid ? (uint32_t)p : 0;
+    }
+}
+
+void bmp280_compensate_batch(const bmp280_calib_data *calib,
+                             const int32_t *adc_T, const int32_t *adc_P,
+                             int32_t *temp_centi, uint32_t *press_q8, size_t n)
+{
+    int32_t t_fine[COMPENSATE_BLOCK];
+
+    if (!calib || !adc_T || !adc_P || !temp_centi || !press_q8)
+        return;
+
+    for (size_t off = 0; off < n; off += COMPENSATE_BLOCK)
+    {
+        size_t len = (n - off < COMPENSATE_BLOCK) ? n - off : COMPENSATE_BLOCK;
+
+        bmp280_compensate_temperature(calib, adc_T + off, t_fine, temp_centi + off, len);
+        bmp280_compensate_pressure(calib, adc_P + off, t_fine, press_q8 + off, len);
+    }
+}
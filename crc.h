@@ -2,9 +2,10 @@
 #define HTU21D_CRC_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 // Function to compute CRC-8 using polynomial 0x31 (x⁸ + x⁵ + x⁴ + 1)
-uint8_t compute_crc8(const uint8_t *data, uint8_t length)
+static inline uint8_t compute_crc8(const uint8_t *data, uint8_t length)
 {
     uint8_t crc = 0x00; // Initial value
 
@@ -27,4 +28,25 @@ uint8_t compute_crc8(const uint8_t *data, uint8_t length)
     return crc;
 }
 
+/*
+    CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320), nibble table.
+    `crc` is the running value: 0 to start, or the result over the previous
+    bytes to extend it (crc32(crc32(0, a), b) == crc32(0, a + b)).
+*/
+static inline uint32_t compute_crc32(uint32_t crc, const void *data, size_t length)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = (crc >> 4) ^ table[(crc ^ bytes[i]) & 0x0F];
+        crc = (crc >> 4) ^ table[(crc ^ (bytes[i] >> 4)) & 0x0F];
+    }
+    return ~crc;
+}
+
 #endif /* HTU21D_CRC_H */
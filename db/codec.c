@@ -0,0 +1,367 @@
+#include "codec.h"
+#include <string.h>
+
+/****************** Bit stream (MSB first) ******************/
+
+static int put_bits(struct sensors_codec_encoder *enc, uint64_t value, unsigned bits)
+{
+    if (enc->bit_pos + bits > enc->size * 8)
+        return -1;
+
+    for (unsigned i = bits; i-- > 0;)
+    {
+        if ((value >> i) & 1)
+            enc->buf[enc->bit_pos / 8] |= 0x80 >> (enc->bit_pos % 8);
+        enc->bit_pos++;
+    }
+
+    return 0;
+}
+
+static int get_bits(struct sensors_codec_decoder *dec, unsigned bits, uint64_t *value)
+{
+    if (dec->bit_pos + bits > dec->size * 8)
+        return -1;
+
+    *value = 0;
+    for (unsigned i = 0; i < bits; i++)
+    {
+        *value = (*value << 1) | ((dec->buf[dec->bit_pos / 8] >> (7 - dec->bit_pos % 8)) & 1);
+        dec->bit_pos++;
+    }
+
+    return 0;
+}
+
+/****************** Variable-length signed deltas ******************/
+
+static const struct
+{
+    uint64_t prefix;
+    unsigned prefix_bits;
+    unsigned value_bits;
+} buckets[] = {
+    {0x0, 1, 0},
+    {0x2, 2, 6},
+    {0x6, 3, 12},
+    {0xE, 4, 20},
+    {0xF, 4, 64},
+};
+
+#define BUCKETS (sizeof(buckets) / sizeof(buckets[0]))
+
+static int put_signed(struct sensors_codec_encoder *enc, int64_t value)
+{
+    size_t b = 0;
+
+    // Smallest bucket whose two's complement range holds `value`
+    while (b < BUCKETS - 1 &&
+           !(buckets[b].value_bits == 0 ? value == 0
+                                        : value >= -(INT64_C(1) << (buckets[b].value_bits - 1)) &&
+                                              value < (INT64_C(1) << (buckets[b].value_bits - 1))))
+        b++;
+
+    if (put_bits(enc, buckets[b].prefix, buckets[b].prefix_bits) < 0)
+        return -1;
+
+    if (buckets[b].value_bits == 0)
+        return 0;
+
+    uint64_t mask = buckets[b].value_bits == 64 ? UINT64_MAX : (UINT64_C(1) << buckets[b].value_bits) - 1;
+
+    return put_bits(enc, (uint64_t)value & mask, buckets[b].value_bits);
+}
+
+static int get_signed(struct sensors_codec_decoder *dec, int64_t *value)
+{
+    uint64_t bit, raw;
+    size_t b = 0;
+
+    // Prefix: one '1' per bucket skipped, at most 4 bits
+    while (b < BUCKETS - 1)
+    {
+        if (get_bits(dec, 1, &bit) < 0)
+            return -1;
+        if (!bit)
+            break;
+        b++;
+    }
+
+    unsigned bits = buckets[b].value_bits;
+    if (bits == 0)
+    {
+        *value = 0;
+        return 0;
+    }
+
+    if (get_bits(dec, bits, &raw) < 0)
+        return -1;
+
+    // Sign-extend
+    if (bits < 64 && (raw >> (bits - 1)) & 1)
+        raw |= ~((UINT64_C(1) << bits) - 1);
+
+    *value = (int64_t)raw;
+    return 0;
+}
+
+/****************** Lanes ******************/
+
+#define LANE_INDEX_BITS 3 // log2(SENSORS_CODEC_LANES)
+
+// Lane of a device new to the block (encoder and decoder must agree)
+static struct sensors_codec_lane *lane_open(struct sensors_codec_state *st, uint16_t device)
+{
+    st->lane = st->lane_count < SENSORS_CODEC_LANES ? st->lane_count++ : SENSORS_CODEC_LANES - 1;
+
+    struct sensors_codec_lane *lane = &st->lanes[st->lane];
+    memset(lane, 0, sizeof(*lane));
+    lane->device = device;
+
+    return lane;
+}
+
+/****************** Encoder ******************/
+
+void sensors_codec_encoder_init(struct sensors_codec_encoder *enc, uint8_t *buf, size_t size)
+{
+    memset(enc, 0, sizeof(*enc));
+    memset(buf, 0, size);
+
+    enc->buf = buf;
+    enc->size = size;
+
+    if (size > 0)
+        put_bits(enc, SENSORS_CODEC_VERSION, 8);
+}
+
+size_t sensors_codec_encoded_size(const struct sensors_codec_encoder *enc)
+{
+    return (enc->bit_pos + 7) / 8;
+}
+
+int sensors_codec_encode(struct sensors_codec_encoder *enc, const struct sensors_sample *sample)
+{
+    struct sensors_codec_state *st = &enc->state;
+    struct sensors_codec_state saved = *st;
+    size_t saved_pos = enc->bit_pos;
+    struct sensors_codec_lane *lane = NULL;
+
+    if (enc->size == 0)
+        return -1;
+
+    if (st->count > 0 && st->lanes[st->lane].device == sample->device)
+    {
+        if (put_bits(enc, 0, 1) < 0)
+            goto err_rewind;
+        lane = &st->lanes[st->lane];
+    }
+    else
+    {
+        for (int i = 0; i < st->lane_count && !lane; i++)
+        {
+            if (st->lanes[i].device == sample->device)
+            {
+                if (put_bits(enc, 0x2, 2) < 0 || put_bits(enc, (uint64_t)i, LANE_INDEX_BITS) < 0)
+                    goto err_rewind;
+                st->lane = i;
+                lane = &st->lanes[i];
+            }
+        }
+
+        if (!lane)
+        {
+            if (put_bits(enc, 0x3, 2) < 0 || put_bits(enc, sample->device, 16) < 0)
+                goto err_rewind;
+            lane = lane_open(st, sample->device);
+        }
+    }
+
+    if (st->count == 0)
+    {
+        if (put_bits(enc, (uint64_t)sample->timestamp_ms, 64) < 0)
+            goto err_rewind;
+    }
+    else if (lane->count == 0)
+    {
+        if (put_signed(enc, sample->timestamp_ms - st->prev_ms) < 0)
+            goto err_rewind;
+    }
+    else
+    {
+        int64_t delta = sample->timestamp_ms - lane->prev_ms;
+
+        if (put_signed(enc, delta - lane->prev_delta_ms) < 0)
+            goto err_rewind;
+        lane->prev_delta_ms = delta;
+    }
+    lane->prev_ms = sample->timestamp_ms;
+    st->prev_ms = sample->timestamp_ms;
+
+    uint32_t valid = sample->valid & SENSORS_SAMPLE_ALL;
+    if (valid == lane->prev_valid)
+    {
+        if (put_bits(enc, 0, 1) < 0)
+            goto err_rewind;
+    }
+    else if (put_bits(enc, 0x8 | valid, 4) < 0)
+        goto err_rewind;
+    lane->prev_valid = valid;
+
+    for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+    {
+        // Invalid channels are skipped and keep the previous reference value
+        if (!(valid & sensors_sample_channel_valid(ch)))
+            continue;
+
+        double scaled = (double)sample->values[ch] * SENSORS_CODEC_SCALE;
+        int64_t q = (int64_t)(scaled + (scaled < 0 ? -0.5 : 0.5));
+
+        if (put_signed(enc, q - lane->prev_q[ch]) < 0)
+            goto err_rewind;
+        lane->prev_q[ch] = q;
+    }
+
+    lane->count++;
+    st->count++;
+    return 0;
+
+err_rewind:
+    // Block full: drop the partial sample so the block stays decodable
+    while (enc->bit_pos > saved_pos)
+    {
+        enc->bit_pos--;
+        enc->buf[enc->bit_pos / 8] &= ~(0x80 >> (enc->bit_pos % 8));
+    }
+    *st = saved;
+    return -1;
+}
+
+/****************** Decoder ******************/
+
+int sensors_codec_decoder_init(struct sensors_codec_decoder *dec, const uint8_t *buf, size_t size, size_t count)
+{
+    memset(dec, 0, sizeof(*dec));
+
+    dec->buf = buf;
+    dec->size = size;
+    dec->total = count;
+
+    uint64_t version;
+    if (!buf || get_bits(dec, 8, &version) < 0 || version < 1 || version > SENSORS_CODEC_VERSION)
+        return -1;
+
+    dec->version = (unsigned)version;
+
+    return 0;
+}
+
+// Version 3 lane selector (see the encoder)
+static struct sensors_codec_lane *decode_lane(struct sensors_codec_decoder *dec)
+{
+    struct sensors_codec_state *st = &dec->state;
+    uint64_t raw;
+
+    if (get_bits(dec, 1, &raw) < 0)
+        return NULL;
+    if (!raw)
+        return st->count > 0 ? &st->lanes[st->lane] : NULL;
+
+    if (get_bits(dec, 1, &raw) < 0)
+        return NULL;
+    if (!raw)
+    {
+        if (get_bits(dec, LANE_INDEX_BITS, &raw) < 0 || (int)raw >= st->lane_count)
+            return NULL;
+        st->lane = (int)raw;
+        return &st->lanes[st->lane];
+    }
+
+    if (get_bits(dec, 16, &raw) < 0)
+        return NULL;
+    return lane_open(st, (uint16_t)raw);
+}
+
+int sensors_codec_decode(struct sensors_codec_decoder *dec, struct sensors_sample *sample)
+{
+    struct sensors_codec_state *st = &dec->state;
+    struct sensors_codec_lane *lane;
+    uint64_t raw;
+    int64_t dod;
+
+    if (st->count == dec->total)
+        return 0;
+
+    memset(sample, 0, sizeof(*sample));
+
+    // Versions 1 and 2: everything in one lane, whose device may change in place
+    if (dec->version >= 3)
+        lane = decode_lane(dec);
+    else
+        lane = st->count > 0 ? &st->lanes[0] : lane_open(st, 0);
+    if (!lane)
+        return -1;
+
+    if (st->count == 0)
+    {
+        if (get_bits(dec, 64, &raw) < 0)
+            return -1;
+        sample->timestamp_ms = (int64_t)raw;
+    }
+    else if (lane->count == 0)
+    {
+        int64_t delta;
+        if (get_signed(dec, &delta) < 0)
+            return -1;
+        sample->timestamp_ms = st->prev_ms + delta;
+    }
+    else
+    {
+        if (get_signed(dec, &dod) < 0)
+            return -1;
+        lane->prev_delta_ms += dod;
+        sample->timestamp_ms = lane->prev_ms + lane->prev_delta_ms;
+    }
+    lane->prev_ms = sample->timestamp_ms;
+    st->prev_ms = sample->timestamp_ms;
+
+    if (get_bits(dec, 1, &raw) < 0)
+        return -1;
+    if (raw)
+    {
+        if (get_bits(dec, 3, &raw) < 0)
+            return -1;
+        lane->prev_valid = (uint32_t)raw;
+    }
+    sample->valid = (uint16_t)lane->prev_valid;
+
+    if (dec->version == 2)
+    {
+        if (get_bits(dec, 1, &raw) < 0)
+            return -1;
+        if (raw)
+        {
+            if (get_bits(dec, 16, &raw) < 0)
+                return -1;
+            lane->device = (uint16_t)raw;
+        }
+    }
+    sample->device = lane->device;
+
+    for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+    {
+        if (!(sample->valid & sensors_sample_channel_valid(ch)))
+            continue;
+
+        int64_t delta;
+        if (get_signed(dec, &delta) < 0)
+            return -1;
+
+        lane->prev_q[ch] += delta;
+        sample->values[ch] = (float)((double)lane->prev_q[ch] / SENSORS_CODEC_SCALE);
+    }
+
+    lane->count++;
+    st->count++;
+    return 1;
+}
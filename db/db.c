@@ -1,81 +1,99 @@
 #include "db.h"
+#include "db_sqlite.h"
 #include <stdio.h>
 #include <stdlib.h>
 
-struct sensors_db *sensors_db_init(char *db_file, int data_limit)
+struct sensors_db *sensors_db_init(char *db_file, int data_limit, const struct sensors_db_policy *policy)
 {
+    if (!db_file)
+        return NULL;
 
-    struct sensors_db *sens_db = (struct sensors_db *)malloc(sizeof(struct sensors_db));
+    return sensors_db_init_backend(&sensors_db_sqlite_ops, sensors_db_sqlite_open(db_file, data_limit, policy));
+}
 
-    if (!sens_db)
+struct sensors_db *sensors_db_init_backend(const struct sensors_db_backend_ops *ops, void *backend)
+{
+    if (!ops || !backend)
     {
         return NULL;
     }
 
-    // Open or create the SQLite database
-    int rc = sqlite3_open(db_file, &sens_db->db);
-    if (rc != SQLITE_OK)
-    {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(sens_db->db));
-        sqlite3_close(sens_db->db);
-        return NULL;
-    }
+    struct sensors_db *sens_db = (struct sensors_db *)calloc(1, sizeof(struct sensors_db));
 
-    // Create the table if it doesn't exist
-    const char *create_table_sql =
-        "CREATE TABLE IF NOT EXISTS SensorData ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-        "timestamp DATETIME DEFAULT CURRENT_TIMESTAMP, " // Automatically add current time
-        "bmp280_temperature REAL, "
-        "bmp280_pressure REAL, "
-        "htu21d_temperature REAL, "
-        "htu21d_humidity REAL);";
-
-    rc = sqlite3_exec(sens_db->db, create_table_sql, 0, 0, &sens_db->err_msg);
-    if (rc != SQLITE_OK)
+    if (!sens_db)
     {
-        fprintf(stderr, "SQL error: %s\n", sens_db->err_msg);
-        sqlite3_free(sens_db->err_msg);
-        sqlite3_close(sens_db->db);
+        ops->close(backend);
         return NULL;
     }
 
-    sens_db->data_limit = data_limit;
+    sens_db->ops = ops;
+    sens_db->backend = backend;
 
     return sens_db;
 }
 
+int64_t sensors_db_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int sensors_db_store_sample(struct sensors_db *self, const struct sensors_sample *sample)
+{
+    if (!self || !sample)
+        return -1;
+
+    return self->ops->store(self->backend, sample);
+}
+
 int sensors_db_store_data(struct sensors_db *self, float bmp280_temp, float bmp280_pressure, float htu21d_temp, float htu21d_humidity)
 {
+    // Timestamp taken now, not at commit time
+    struct sensors_sample sample = {
+        .timestamp_ms = sensors_db_now_ms(),
+        .values = {bmp280_temp, bmp280_pressure, htu21d_temp, htu21d_humidity},
+        .valid = SENSORS_SAMPLE_ALL,
+    };
+
+    return sensors_db_store_sample(self, &sample);
+}
+
+int sensors_db_describe_device(struct sensors_db *self, const struct sensors_device_info *info)
+{
+    if (!self || !info)
+        return -1;
 
-    // Insert new sensor data into the database
-    char insert_sql[512];
-    snprintf(insert_sql, sizeof(insert_sql),
-             "INSERT INTO SensorData (bmp280_temperature, bmp280_pressure, htu21d_temperature, htu21d_humidity) "
-             "VALUES (%.2f, %.2f, %.2f, %.2f);",
-             bmp280_temp, bmp280_pressure, htu21d_temp, htu21d_humidity);
+    if (!self->ops->describe_device)
+        return 0;
 
-    int rc = sqlite3_exec(self->db, insert_sql, 0, 0, &self->err_msg);
-    if (rc != SQLITE_OK)
-    {
-        fprintf(stderr, "SQL error: %s\n", self->err_msg);
+    return self->ops->describe_device(self->backend, info);
+}
+
+int sensors_db_flush(struct sensors_db *self)
+{
+    if (!self)
         return -1;
-    }
 
-    // Delete older entries if more than 10 samples exist
-    char delete_sql[512];
-    snprintf(delete_sql, sizeof(delete_sql), "DELETE FROM SensorData WHERE id NOT IN (SELECT id FROM SensorData ORDER BY id DESC LIMIT %d);", self->data_limit);
-    rc = sqlite3_exec(self->db, delete_sql, 0, 0, &self->err_msg);
-    if (rc != SQLITE_OK)
-    {
-        fprintf(stderr, "SQL error while deleting old data: %s\n", self->err_msg);
-    }
+    return self->ops->flush(self->backend);
+}
+
+int sensors_db_flush_due(struct sensors_db *self)
+{
+    if (!self)
+        return -1;
 
-    return 0;
+    if (!self->ops->flush_due)
+        return 0;
+
+    return self->ops->flush_due(self->backend);
 }
 
 void sensors_db_close(struct sensors_db *self)
 {
-    sqlite3_free(self->err_msg);
-    sqlite3_close(self->db);
+    if (!self)
+        return;
+
+    self->ops->close(self->backend);
+    free(self);
 }
@@ -1,20 +1,116 @@
 #ifndef SENSORS_DB_H
 #define SENSORS_DB_H
 
-// #include <time.h>    // For timestamps
-#include <sqlite3.h> // SQLite library
+#include <time.h>    // For timestamps
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SENSORS_DB_CHANNELS 4 // bmp280 T/P, htu21d T/RH, in storage column order
+
+// sensors_sample.valid bits
+#define SENSORS_SAMPLE_BMP280 0x01          // bmp280 temperature and pressure
+#define SENSORS_SAMPLE_HTU21D_TEMP 0x02     // htu21d temperature
+#define SENSORS_SAMPLE_HTU21D_HUMIDITY 0x04 // htu21d humidity
+#define SENSORS_SAMPLE_ALL (SENSORS_SAMPLE_BMP280 | SENSORS_SAMPLE_HTU21D_TEMP | SENSORS_SAMPLE_HTU21D_HUMIDITY)
+
+/*
+    One acquisition: compensated values plus the raw ADC words they came
+    from, so history can be recompensated later. Also the on-disk record of
+    the segment backend (40 bytes, native endianness).
+    `device` is the registry id of the sensor that produced the sample
+    (see registry/device_registry.h), 0 when unknown: records written
+    before it existed read back as device 0 on little-endian hosts.
+*/
+struct sensors_sample
+{
+    int64_t timestamp_ms;                // Unix time, milliseconds
+    float values[SENSORS_DB_CHANNELS];   // °C, hPa, °C, %RH
+    int32_t bmp280_adc_T, bmp280_adc_P;  // 20-bit ADC
+    uint16_t htu21d_raw_temp;            // as read, status bits included
+    uint16_t htu21d_raw_humidity;
+    uint16_t valid;                      // SENSORS_SAMPLE_* bits
+    uint16_t device;                     // registry id, 0: unknown
+};
+
+// Validity bit covering channel `ch` (index in sensors_sample.values)
+static inline uint32_t sensors_sample_channel_valid(int ch)
+{
+    return ch < 2 ? SENSORS_SAMPLE_BMP280 : ch == 2 ? SENSORS_SAMPLE_HTU21D_TEMP : SENSORS_SAMPLE_HTU21D_HUMIDITY;
+}
+
+/*
+    History readers get samples in chunks, pointing into the reader's own
+    storage (valid during the call only). Return non-zero to stop the scan.
+*/
+typedef int (*sensors_db_scan_cb)(const struct sensors_sample *records, size_t count, void *arg);
+
+// Where a device id comes from, so stored samples can be traced back to a sensor
+struct sensors_device_info
+{
+    uint16_t id;
+    const char *name;
+    const char *driver;
+    const char *bus;     // parent bus device path
+    uint8_t address;
+    int mux_address;     // -1: directly on the bus
+    int mux_channel;     // -1: directly on the bus
+};
+
+/*
+    Storage backend: keeps samples somewhere. Only ever called from the
+    thread that owns the sensors_db.
+*/
+struct sensors_db_backend_ops
+{
+    const char *name;
+    // All return 0 on success, -1 on failure
+    int (*store)(void *backend, const struct sensors_sample *sample);
+    int (*flush)(void *backend); // make what was stored so far durable
+    int (*flush_due)(void *backend); // flush if the batching time bound has passed, may be NULL
+    void (*close)(void *backend); // flushes first
+    int (*describe_device)(void *backend, const struct sensors_device_info *info); // may be NULL
+};
 
 struct sensors_db
 {
-    sqlite3 *db;
-    char *err_msg;
-    int data_limit;
+    const struct sensors_db_backend_ops *ops;
+    void *backend;
 };
 
-struct sensors_db *sensors_db_init(char *db_file, int data_limit);
+struct sensors_db_policy; // db_sqlite.h
+
+/*
+    SQLite store (see db_sqlite.h): `data_limit` raw samples kept, `policy`
+    may be NULL (SENSORS_DB_POLICY_DEFAULT).
+*/
+struct sensors_db *sensors_db_init(char *db_file, int data_limit, const struct sensors_db_policy *policy);
+
+// Same, on top of an already opened backend (ownership is transferred)
+struct sensors_db *sensors_db_init_backend(const struct sensors_db_backend_ops *ops, void *backend);
 
+int sensors_db_store_sample(struct sensors_db *self, const struct sensors_sample *sample);
+
+// Store compensated values only, timestamped now
 int sensors_db_store_data(struct sensors_db *self, float bmp280_temp, float bmp280_pressure, float htu21d_temp, float htu21d_humidity);
 
+// Record what a device id stands for (0 if the backend does not keep it)
+int sensors_db_describe_device(struct sensors_db *self, const struct sensors_device_info *info);
+
+// Make the stored samples durable now (0 if there was nothing to do)
+int sensors_db_flush(struct sensors_db *self);
+
+/*
+    Flush if pending samples have waited longer than the backend allows:
+    stores only check that when the next sample comes in, so the storing
+    thread calls this when it has been idle for a while.
+*/
+int sensors_db_flush_due(struct sensors_db *self);
+
+// Flushes the pending samples, then closes the database
 void sensors_db_close(struct sensors_db *self);
 
-#endif /* SENSORS_DB_H */
\ No newline at end of file
+// Current Unix time in milliseconds, for sensors_sample.timestamp_ms
+int64_t sensors_db_now_ms(void);
+
+#endif /* SENSORS_DB_H */
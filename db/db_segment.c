@@ -0,0 +1,426 @@
+#include "db_segment.h"
+#include "crc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SEGMENT_SUFFIX ".seg"
+#define SEGMENT_NAME_LEN (16 + sizeof(SEGMENT_SUFFIX) - 1)
+
+_Static_assert(sizeof(struct sensors_sample) == 40, "sensors_sample is an on-disk record");
+_Static_assert(sizeof(struct sensors_db_block) <= SENSORS_DB_SEGMENT_BLOCK_SIZE, "block overflow");
+
+/****************** Segment files ******************/
+
+static int segment_filter(const struct dirent *entry)
+{
+    size_t len = strlen(entry->d_name);
+
+    return len == SEGMENT_NAME_LEN && strcmp(entry->d_name + 16, SEGMENT_SUFFIX) == 0;
+}
+
+// Segment names, oldest first (fixed-width hex sorts numerically); returns the count or -1
+static int segment_list(const char *dir, struct dirent ***list)
+{
+    int n = scandir(dir, list, segment_filter, alphasort);
+    if (n < 0)
+        perror("Failed to list segments");
+
+    return n;
+}
+
+static void segment_list_free(struct dirent **list, int n)
+{
+    for (int i = 0; i < n; i++)
+        free(list[i]);
+    free(list);
+}
+
+static struct sensors_db_block *block_at(uint8_t *map, size_t index)
+{
+    return (struct sensors_db_block *)(map + index * SENSORS_DB_SEGMENT_BLOCK_SIZE);
+}
+
+static bool block_valid(const struct sensors_db_block *blk)
+{
+    const struct sensors_db_block_header *h = &blk->header;
+
+    if (h->magic != SENSORS_DB_SEGMENT_MAGIC || h->version != SENSORS_DB_SEGMENT_VERSION ||
+        h->count == 0 || h->count > SENSORS_DB_SEGMENT_RECORDS)
+        return false;
+
+    if (h->header_crc != compute_crc32(0, h, offsetof(struct sensors_db_block_header, header_crc)))
+        return false;
+
+    return h->data_crc == compute_crc32(0, blk->records, h->count * sizeof(struct sensors_sample));
+}
+
+// Map a whole segment file, returns its size in blocks (0 on error)
+static size_t segment_map(const char *path, int flags, int *fd, uint8_t **map)
+{
+    struct stat st;
+
+    *fd = open(path, flags);
+    if (*fd < 0)
+    {
+        perror("Failed to open segment");
+        return 0;
+    }
+
+    if (fstat(*fd, &st) < 0 || st.st_size < SENSORS_DB_SEGMENT_BLOCK_SIZE)
+    {
+        close(*fd);
+        return 0;
+    }
+
+    int prot = (flags & O_ACCMODE) == O_RDWR ? PROT_READ | PROT_WRITE : PROT_READ;
+
+    *map = mmap(NULL, st.st_size, prot, MAP_SHARED, *fd, 0);
+    if (*map == MAP_FAILED)
+    {
+        perror("Failed to map segment");
+        close(*fd);
+        return 0;
+    }
+
+    return st.st_size / SENSORS_DB_SEGMENT_BLOCK_SIZE;
+}
+
+/****************** Writer ******************/
+
+static void segment_unmap(struct sensors_db_segment *self, int sync_flag)
+{
+    if (!self->map)
+        return;
+
+    msync(self->map, self->map_blocks * SENSORS_DB_SEGMENT_BLOCK_SIZE, sync_flag);
+    munmap(self->map, self->map_blocks * SENSORS_DB_SEGMENT_BLOCK_SIZE);
+    close(self->fd);
+    self->map = NULL;
+}
+
+// Delete the oldest segments beyond max_segments
+static void segment_prune(struct sensors_db_segment *self)
+{
+    struct dirent **list;
+    char path[PATH_MAX];
+
+    if (self->max_segments <= 0)
+        return;
+
+    int n = segment_list(self->dir, &list);
+    if (n < 0)
+        return;
+
+    for (int i = 0; i < n - self->max_segments; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", self->dir, list[i]->d_name);
+        unlink(path);
+    }
+
+    segment_list_free(list, n);
+}
+
+// Start a new segment at next_seq, its blocks allocated up front so stores never fault on a full disk
+static int segment_rotate(struct sensors_db_segment *self)
+{
+    char path[PATH_MAX];
+    size_t size = self->segment_blocks * SENSORS_DB_SEGMENT_BLOCK_SIZE;
+
+    segment_unmap(self, MS_ASYNC);
+
+    snprintf(path, sizeof(path), "%s/%016llx" SEGMENT_SUFFIX, self->dir, (unsigned long long)self->next_seq);
+
+    self->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (self->fd < 0)
+    {
+        perror("Failed to create segment");
+        return -1;
+    }
+
+    int err = posix_fallocate(self->fd, 0, size);
+    if (err != 0)
+    {
+        errno = err;
+        perror("Failed to allocate segment");
+        close(self->fd);
+        unlink(path);
+        return -1;
+    }
+
+    self->map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, self->fd, 0);
+    if (self->map == MAP_FAILED)
+    {
+        perror("Failed to map segment");
+        self->map = NULL;
+        close(self->fd);
+        return -1;
+    }
+
+    self->map_blocks = self->segment_blocks;
+    self->block = 0;
+
+    // Make the new name durable
+    int dir_fd = open(self->dir, O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0)
+    {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+
+    segment_prune(self);
+
+    return 0;
+}
+
+// Reopen the newest segment and find where appending resumes
+static int segment_recover(struct sensors_db_segment *self)
+{
+    struct dirent **list;
+    char path[PATH_MAX];
+
+    int n = segment_list(self->dir, &list);
+    if (n < 0)
+        return -1;
+
+    if (n == 0)
+    {
+        free(list);
+        return 0; // first segment created by the first store
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", self->dir, list[n - 1]->d_name);
+    self->next_seq = strtoull(list[n - 1]->d_name, NULL, 16);
+    segment_list_free(list, n);
+
+    self->map_blocks = segment_map(path, O_RDWR, &self->fd, &self->map);
+    if (self->map_blocks == 0)
+    {
+        // Creation interrupted before the blocks were allocated: start it again
+        self->map = NULL;
+        unlink(path);
+        return 0;
+    }
+
+    for (self->block = 0; self->block < self->map_blocks; self->block++)
+    {
+        struct sensors_db_block *blk = block_at(self->map, self->block);
+
+        if (!block_valid(blk))
+        {
+            // Never written, or torn by a power cut: restart the block
+            memset(&blk->header, 0, sizeof(blk->header));
+            break;
+        }
+
+        self->next_seq = blk->header.first_seq + blk->header.count;
+
+        if (blk->header.count < SENSORS_DB_SEGMENT_RECORDS)
+            break;
+    }
+
+    return 0;
+}
+
+void *sensors_db_segment_open(const char *dir, size_t segment_blocks, int max_segments)
+{
+    if (!dir || segment_blocks == 0)
+        return NULL;
+
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+    {
+        perror("Failed to create segment directory");
+        return NULL;
+    }
+
+    struct sensors_db_segment *self = (struct sensors_db_segment *)calloc(1, sizeof(struct sensors_db_segment));
+
+    if (!self)
+        return NULL;
+
+    self->dir = strdup(dir);
+    self->segment_blocks = segment_blocks;
+    self->max_segments = max_segments;
+
+    if (!self->dir || segment_recover(self) < 0)
+    {
+        free(self->dir);
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+static int sensors_db_segment_store(void *backend, const struct sensors_sample *sample)
+{
+    struct sensors_db_segment *self = (struct sensors_db_segment *)backend;
+
+    if ((!self->map || self->block == self->map_blocks) && segment_rotate(self) < 0)
+        return -1;
+
+    struct sensors_db_block *blk = block_at(self->map, self->block);
+    struct sensors_db_block_header *h = &blk->header;
+
+    if (h->count == 0)
+    {
+        h->magic = SENSORS_DB_SEGMENT_MAGIC;
+        h->version = SENSORS_DB_SEGMENT_VERSION;
+        h->first_seq = self->next_seq;
+        h->first_ms = sample->timestamp_ms;
+        h->data_crc = 0;
+    }
+
+    // Record first, then the header that makes it visible to readers
+    blk->records[h->count] = *sample;
+    h->data_crc = compute_crc32(h->data_crc, &blk->records[h->count], sizeof(struct sensors_sample));
+    h->last_ms = sample->timestamp_ms;
+    h->count++;
+    h->header_crc = compute_crc32(0, h, offsetof(struct sensors_db_block_header, header_crc));
+
+    self->next_seq++;
+
+    if (h->count == SENSORS_DB_SEGMENT_RECORDS)
+    {
+        msync(blk, SENSORS_DB_SEGMENT_BLOCK_SIZE, MS_ASYNC);
+        self->block++;
+    }
+
+    return 0;
+}
+
+static int sensors_db_segment_flush(void *backend)
+{
+    struct sensors_db_segment *self = (struct sensors_db_segment *)backend;
+
+    if (!self->map)
+        return 0;
+
+    if (msync(self->map, self->map_blocks * SENSORS_DB_SEGMENT_BLOCK_SIZE, MS_SYNC) < 0)
+    {
+        perror("Failed to sync segment");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void sensors_db_segment_close(void *backend)
+{
+    struct sensors_db_segment *self = (struct sensors_db_segment *)backend;
+
+    segment_unmap(self, MS_SYNC);
+    free(self->dir);
+    free(self);
+}
+
+const struct sensors_db_backend_ops sensors_db_segment_ops = {
+    .name = "segment",
+    .store = sensors_db_segment_store,
+    .flush = sensors_db_segment_flush,
+    .close = sensors_db_segment_close,
+};
+
+/****************** Reader ******************/
+
+static int segment_scan_file(const char *path, int64_t from_ms, int64_t to_ms, sensors_db_scan_cb cb, void *arg)
+{
+    int fd, ret = 0;
+    uint8_t *map;
+
+    size_t blocks = segment_map(path, O_RDONLY, &fd, &map);
+    if (blocks == 0)
+        return 0; // deleted by retention meanwhile, or empty
+
+    for (size_t b = 0; b < blocks && ret == 0; b++)
+    {
+        const struct sensors_db_block *blk = block_at(map, b);
+
+        if (!block_valid(blk))
+            continue;
+
+        const struct sensors_db_block_header *h = &blk->header;
+        if (h->last_ms < from_ms || h->first_ms > to_ms)
+            continue;
+
+        // Trim the block to the requested range
+        size_t first = 0, end = h->count;
+        while (first < end && blk->records[first].timestamp_ms < from_ms)
+            first++;
+        while (end > first && blk->records[end - 1].timestamp_ms > to_ms)
+            end--;
+
+        if (end > first)
+            ret = cb(&blk->records[first], end - first, arg);
+    }
+
+    munmap(map, blocks * SENSORS_DB_SEGMENT_BLOCK_SIZE);
+    close(fd);
+
+    return ret;
+}
+
+int sensors_db_segment_clear(const char *dir)
+{
+    struct dirent **list;
+    char path[PATH_MAX];
+    int ret = 0;
+
+    if (!dir)
+        return -1;
+
+    int n = scandir(dir, &list, segment_filter, alphasort);
+    if (n < 0)
+    {
+        if (errno == ENOENT)
+            return 0;
+
+        perror("Failed to list segments");
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, list[i]->d_name);
+        if (unlink(path) < 0)
+        {
+            perror("Failed to delete a segment");
+            ret = -1;
+        }
+    }
+
+    segment_list_free(list, n);
+
+    return ret;
+}
+
+int sensors_db_segment_scan(const char *dir, int64_t from_ms, int64_t to_ms, sensors_db_scan_cb cb, void *arg)
+{
+    struct dirent **list;
+    char path[PATH_MAX];
+    int ret = 0;
+
+    if (!dir || !cb)
+        return -1;
+
+    int n = segment_list(dir, &list);
+    if (n < 0)
+        return -1;
+
+    for (int i = 0; i < n && ret == 0; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, list[i]->d_name);
+        ret = segment_scan_file(path, from_ms, to_ms, cb, arg);
+    }
+
+    segment_list_free(list, n);
+
+    return ret;
+}
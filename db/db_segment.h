@@ -0,0 +1,79 @@
+#ifndef SENSORS_DB_SEGMENT_H
+#define SENSORS_DB_SEGMENT_H
+
+/*
+    Append-only binary storage backend: a directory of fixed-size segment
+    files named after the sequence number of their first sample
+    (%016llx.seg). A segment is a run of 4 KiB blocks, each one a
+    CRC-protected header followed by up to SENSORS_DB_SEGMENT_RECORDS
+    struct sensors_sample records.
+
+    The writer appends into a shared mapping of the current segment, i.e.
+    straight into the page cache: a store is a 40-byte copy plus two
+    incremental CRCs. Full blocks are handed to writeback (msync MS_ASYNC),
+    flush/close wait for it. After a power cut only the tail block can fail
+    its CRC, it is discarded on the next open.
+*/
+
+#include "db.h"
+#include <stddef.h>
+
+#define SENSORS_DB_SEGMENT_MAGIC 0x31425354 // "TSB1"
+#define SENSORS_DB_SEGMENT_VERSION 1
+#define SENSORS_DB_SEGMENT_BLOCK_SIZE 4096
+
+// Default segment: 256 blocks (1 MiB), 25856 samples: about 6.5 h of the default station (1.1 samples/s)
+#define SENSORS_DB_SEGMENT_BLOCKS 256
+
+struct sensors_db_block_header
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;      // records in use
+    uint64_t first_seq;  // sample number of records[0]
+    int64_t first_ms;    // timestamp range of the block, lets readers skip it
+    int64_t last_ms;
+    uint32_t data_crc;   // CRC-32 of records[0..count)
+    uint32_t header_crc; // CRC-32 of the fields above
+};
+
+#define SENSORS_DB_SEGMENT_RECORDS \
+    ((SENSORS_DB_SEGMENT_BLOCK_SIZE - sizeof(struct sensors_db_block_header)) / sizeof(struct sensors_sample))
+
+struct sensors_db_block
+{
+    struct sensors_db_block_header header;
+    struct sensors_sample records[SENSORS_DB_SEGMENT_RECORDS];
+};
+
+struct sensors_db_segment
+{
+    char *dir;
+    size_t segment_blocks; // size of the segments created from now on
+    int max_segments;      // oldest segments are deleted beyond this, 0 keeps them all
+
+    // Segment being written
+    int fd;
+    uint8_t *map;
+    size_t map_blocks;
+    size_t block; // block being filled
+
+    uint64_t next_seq;
+};
+
+extern const struct sensors_db_backend_ops sensors_db_segment_ops;
+
+// Open (or create) the store in `dir`, returns the backend handle or NULL
+void *sensors_db_segment_open(const char *dir, size_t segment_blocks, int max_segments);
+
+// Delete every segment in `dir` (store closed; other files are left alone), returns 0 or -1
+int sensors_db_segment_clear(const char *dir);
+
+/*
+    Scan the samples with from_ms <= timestamp <= to_ms, oldest segment
+    first, one block at a time, straight from a read-only mapping (no copy). Blocks failing their CRC (torn tail, block being written) are
+    skipped. Returns 0, the callback's non-zero value, or -1 on error.
+*/
+int sensors_db_segment_scan(const char *dir, int64_t from_ms, int64_t to_ms, sensors_db_scan_cb cb, void *arg);
+
+#endif /* SENSORS_DB_SEGMENT_H */
@@ -0,0 +1,842 @@
+#include "db_sqlite.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *const channel_names[SENSORS_DB_CHANNELS] = {
+    "bmp280_temperature",
+    "bmp280_pressure",
+    "htu21d_temperature",
+    "htu21d_humidity",
+};
+
+static const struct
+{
+    const char *table;
+    int64_t period_ms;
+} rollup_tiers[SENSORS_DB_ROLLUP_COUNT] = {
+    [SENSORS_DB_ROLLUP_MINUTE] = {"SensorRollup1m", 60 * 1000LL},
+    [SENSORS_DB_ROLLUP_HOUR] = {"SensorRollup1h", 60 * 60 * 1000LL},
+    [SENSORS_DB_ROLLUP_DAY] = {"SensorRollup1d", 24 * 60 * 60 * 1000LL},
+};
+
+static const char *const rollup_columns[] = {"min", "max", "sum", "last"};
+#define ROLLUP_COLUMNS (sizeof(rollup_columns) / sizeof(rollup_columns[0]))
+
+static int sensors_db_prepare(struct sensors_db_sqlite *self, const char *sql, sqlite3_stmt **stmt)
+{
+    int rc = sqlite3_prepare_v3(self->db, sql, -1, SQLITE_PREPARE_PERSISTENT, stmt, NULL);
+    if (rc != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error while preparing statement: %s\n", sqlite3_errmsg(self->db));
+        return -1;
+    }
+
+    return 0;
+}
+
+// Next sample number: one past the newest stored sample (index lookup)
+static int sensors_db_load_next_seq(struct sensors_db_sqlite *self)
+{
+    sqlite3_stmt *stmt;
+
+    if (sensors_db_prepare(self, "SELECT IFNULL(MAX(seq) + 1, 0) FROM SensorRing;", &stmt) < 0)
+        return -1;
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW)
+        self->next_seq = sqlite3_column_int64(stmt, 0);
+
+    sqlite3_finalize(stmt);
+
+    return (rc == SQLITE_ROW) ? 0 : -1;
+}
+
+// Run a prepared statement that returns no rows
+static int sensors_db_step(struct sensors_db_sqlite *self, sqlite3_stmt *stmt)
+{
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(self->db));
+        return -1;
+    }
+
+    return 0;
+}
+
+static int sensors_db_apply_policy(struct sensors_db_sqlite *self)
+{
+    char pragma_sql[128];
+
+    snprintf(pragma_sql, sizeof(pragma_sql), "PRAGMA journal_mode=%s; PRAGMA synchronous=%d;",
+             self->policy.wal ? "WAL" : "DELETE", self->policy.synchronous);
+
+    int rc = sqlite3_exec(self->db, pragma_sql, 0, 0, &self->err_msg);
+    if (rc != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", self->err_msg);
+        sqlite3_free(self->err_msg);
+        self->err_msg = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static bool sensors_db_batch_due(struct sensors_db_sqlite *self)
+{
+    if (self->pending_count >= self->policy.batch_samples)
+        return true;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec - self->pending_since.tv_sec >= self->policy.batch_seconds;
+}
+
+/****************** Rollups ******************/
+
+// printf-style append to `sql`, a buffer of `size` bytes
+__attribute__((format(printf, 3, 4))) static void sql_append(char *sql, size_t size, const char *fmt, ...)
+{
+    size_t len = strlen(sql);
+    va_list args;
+
+    va_start(args, fmt);
+    vsnprintf(sql + len, size - len, fmt, args);
+    va_end(args);
+}
+
+// Keyed by (device_id, bucket) without a rowid: per-device time range queries are plain range scans
+static void sensors_db_rollup_create_sql(char *sql, size_t size, const char *table)
+{
+    sql[0] = '\0';
+    sql_append(sql, size, "CREATE TABLE IF NOT EXISTS %s (device_id INTEGER NOT NULL, bucket INTEGER NOT NULL, count INTEGER NOT NULL", table);
+    for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+        for (size_t col = 0; col < ROLLUP_COLUMNS; col++)
+            sql_append(sql, size, ", %s_%s REAL", channel_names[ch], rollup_columns[col]);
+    for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+        sql_append(sql, size, ", %s_count INTEGER", channel_names[ch]);
+    sql_append(sql, size, ", PRIMARY KEY (device_id, bucket)) WITHOUT ROWID;");
+    sql_append(sql, size, "CREATE INDEX IF NOT EXISTS %s_bucket ON %s (bucket);", table, table);
+}
+
+static int sensors_db_exec(struct sensors_db_sqlite *self, const char *sql)
+{
+    int rc = sqlite3_exec(self->db, sql, 0, 0, &self->err_msg);
+    if (rc != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", self->err_msg);
+        sqlite3_free(self->err_msg);
+        self->err_msg = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+    SensorRing has one column per sensors_sample channel, named after it
+    (device_id says which device the values come from). Like the sample,
+    the codec and the rollups it follows SENSORS_DB_CHANNELS, so its
+    statements are generated from channel_names[]: `fmt` is appended once
+    per channel, with the column name as its (repeated) argument.
+*/
+static void sensors_db_ring_columns(char *sql, size_t size, const char *fmt)
+{
+    for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+        sql_append(sql, size, fmt, channel_names[ch], channel_names[ch]);
+}
+
+// Open row of `device`, added on its first sample (NULL if out of memory)
+static struct sensors_db_rollup_row *sensors_db_rollup_row(struct sensors_db_rollup_tier *tier, uint16_t device)
+{
+    for (int i = 0; i < tier->open_count; i++)
+        if (tier->open[i].device == device)
+            return &tier->open[i];
+
+    if (tier->open_count == tier->open_size)
+    {
+        int size = tier->open_size ? tier->open_size * 2 : 4;
+        struct sensors_db_rollup_row *open = (struct sensors_db_rollup_row *)realloc(tier->open, size * sizeof(*open));
+        if (!open)
+            return NULL;
+
+        tier->open = open;
+        tier->open_size = size;
+    }
+
+    struct sensors_db_rollup_row *row = &tier->open[tier->open_count++];
+    memset(row, 0, sizeof(*row));
+    row->device = device;
+
+    return row;
+}
+
+// Table, retention and persistent statements of one tier
+static int sensors_db_rollup_open(struct sensors_db_sqlite *self, enum sensors_db_rollup tier_id)
+{
+    struct sensors_db_rollup_tier *tier = &self->rollups[tier_id];
+    const char *table = rollup_tiers[tier_id].table;
+    char sql[8192];
+
+    sensors_db_rollup_create_sql(sql, sizeof(sql), table);
+    if (sensors_db_exec(self, sql) < 0)
+        return -1;
+
+    tier->closed = (struct sensors_db_rollup_row *)calloc(self->policy.batch_samples, sizeof(struct sensors_db_rollup_row));
+    if (!tier->closed)
+        return -1;
+
+    /*
+        The accumulators only hold what arrived since the last commit: merge
+        it into the row, so a bucket that is written again (next batch,
+        restart, clock stepped back into it) is completed, never replaced.
+        MIN()/MAX()/+ of a NULL is NULL, hence the COALESCE for channels
+        missing on one side.
+    */
+    sql[0] = '\0';
+    sql_append(sql, sizeof(sql), "INSERT INTO %s VALUES (?1, ?2, ?3", table);
+    for (size_t i = 0; i < SENSORS_DB_CHANNELS * (ROLLUP_COLUMNS + 1); i++)
+        sql_append(sql, sizeof(sql), ", ?");
+    sql_append(sql, sizeof(sql), ") ON CONFLICT (device_id, bucket) DO UPDATE SET count = count + excluded.count");
+    for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+    {
+        const char *c = channel_names[ch];
+
+        sql_append(sql, sizeof(sql), ", %s_min = COALESCE(MIN(%s_min, excluded.%s_min), %s_min, excluded.%s_min)", c, c, c, c, c);
+        sql_append(sql, sizeof(sql), ", %s_max = COALESCE(MAX(%s_max, excluded.%s_max), %s_max, excluded.%s_max)", c, c, c, c, c);
+        sql_append(sql, sizeof(sql), ", %s_sum = COALESCE(%s_sum + excluded.%s_sum, %s_sum, excluded.%s_sum)", c, c, c, c, c);
+        sql_append(sql, sizeof(sql), ", %s_last = COALESCE(excluded.%s_last, %s_last)", c, c, c);
+        sql_append(sql, sizeof(sql), ", %s_count = IFNULL(%s_count, 0) + excluded.%s_count", c, c, c);
+    }
+    sql_append(sql, sizeof(sql), ";");
+
+    if (sensors_db_prepare(self, sql, &tier->upsert_stmt) < 0)
+        return -1;
+
+    snprintf(sql, sizeof(sql), "DELETE FROM %s WHERE bucket < ?1;", table);
+
+    return sensors_db_prepare(self, sql, &tier->retention_stmt);
+}
+
+// Fold the valid channels of `sample` into the open bucket of its device
+static void sensors_db_rollup_add(struct sensors_db_rollup_tier *tier, int64_t period_ms, const struct sensors_sample *sample)
+{
+    struct sensors_db_rollup_row *row = sensors_db_rollup_row(tier, sample->device);
+    int64_t bucket = sample->timestamp_ms - sample->timestamp_ms % period_ms;
+
+    if (!row)
+    {
+        fprintf(stderr, "Rollup: out of memory, sample of device %u not aggregated\n", (unsigned)sample->device);
+        return;
+    }
+
+    // Any other bucket, older ones included (clock stepped back): set this one aside for the merge
+    if (row->count > 0 && row->bucket != bucket)
+    {
+        tier->closed[tier->closed_count++] = *row;
+        row->count = 0;
+    }
+    if (row->count == 0)
+    {
+        row->bucket = bucket;
+        for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+        {
+            row->channel_count[ch] = 0;
+            row->sum[ch] = 0;
+        }
+    }
+
+    row->count++;
+    for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+    {
+        if (!(sample->valid & sensors_sample_channel_valid(ch)))
+            continue;
+
+        double v = sample->values[ch];
+
+        if (row->channel_count[ch] == 0 || v < row->min[ch])
+            row->min[ch] = v;
+        if (row->channel_count[ch] == 0 || v > row->max[ch])
+            row->max[ch] = v;
+        row->sum[ch] += v;
+        row->last[ch] = v;
+        row->channel_count[ch]++;
+    }
+}
+
+static int sensors_db_rollup_write(struct sensors_db_sqlite *self, sqlite3_stmt *stmt, const struct sensors_db_rollup_row *row)
+{
+    sqlite3_bind_int(stmt, 1, row->device);
+    sqlite3_bind_int64(stmt, 2, row->bucket);
+    sqlite3_bind_int64(stmt, 3, row->count);
+    for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+    {
+        int param = 4 + ch * ROLLUP_COLUMNS;
+
+        if (row->channel_count[ch] > 0)
+        {
+            sqlite3_bind_double(stmt, param, row->min[ch]);
+            sqlite3_bind_double(stmt, param + 1, row->max[ch]);
+            sqlite3_bind_double(stmt, param + 2, row->sum[ch]);
+            sqlite3_bind_double(stmt, param + 3, row->last[ch]);
+        }
+        else
+        {
+            for (size_t col = 0; col < ROLLUP_COLUMNS; col++)
+                sqlite3_bind_null(stmt, param + col);
+        }
+
+        sqlite3_bind_int64(stmt, 4 + SENSORS_DB_CHANNELS * ROLLUP_COLUMNS + ch, row->channel_count[ch]);
+    }
+
+    return sensors_db_step(self, stmt);
+}
+
+// Inside the flush transaction: merge the finished buckets and the open ones, then per-tier retention
+static int sensors_db_rollup_flush(struct sensors_db_sqlite *self)
+{
+    for (int tier_id = 0; tier_id < SENSORS_DB_ROLLUP_COUNT; tier_id++)
+    {
+        struct sensors_db_rollup_tier *tier = &self->rollups[tier_id];
+
+        for (int i = 0; i < tier->closed_count; i++)
+            if (sensors_db_rollup_write(self, tier->upsert_stmt, &tier->closed[i]) < 0)
+                return -1;
+
+        int64_t newest = INT64_MIN;
+        for (int i = 0; i < tier->open_count; i++)
+        {
+            if (tier->open[i].count == 0)
+                continue;
+            if (sensors_db_rollup_write(self, tier->upsert_stmt, &tier->open[i]) < 0)
+                return -1;
+            if (tier->open[i].bucket > newest)
+                newest = tier->open[i].bucket;
+        }
+
+        int retention = self->policy.rollup_retention[tier_id];
+        if (tier->closed_count > 0 && retention > 0)
+        {
+            sqlite3_bind_int64(tier->retention_stmt, 1, newest - (int64_t)(retention - 1) * rollup_tiers[tier_id].period_ms);
+            if (sensors_db_step(self, tier->retention_stmt) < 0)
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void sensors_db_rollup_close(struct sensors_db_sqlite *self)
+{
+    for (int tier_id = 0; tier_id < SENSORS_DB_ROLLUP_COUNT; tier_id++)
+    {
+        sqlite3_finalize(self->rollups[tier_id].upsert_stmt);
+        sqlite3_finalize(self->rollups[tier_id].retention_stmt);
+        free(self->rollups[tier_id].closed);
+        free(self->rollups[tier_id].open);
+    }
+}
+
+/****************** Archive ******************/
+
+#define ARCHIVE_SCAN_CHUNK 64
+
+// Encode the ring rows [archive_next_seq, + archive_block_samples) into one block and write it
+static int sensors_db_archive_seal(struct sensors_db_sqlite *self)
+{
+    sqlite3_stmt *stmt = self->seal_stmt;
+    struct sensors_codec_encoder enc;
+    int64_t first_seq = -1, first_ms = 0;
+    int rc;
+
+    sensors_codec_encoder_init(&enc, self->archive_buf,
+                               (size_t)self->policy.archive_block_samples * SENSORS_CODEC_MAX_SAMPLE_BYTES + 1);
+
+    sqlite3_bind_int64(stmt, 1, self->archive_next_seq);
+    sqlite3_bind_int64(stmt, 2, self->archive_next_seq + self->policy.archive_block_samples);
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        struct sensors_sample sample = {0};
+
+        sample.timestamp_ms = sqlite3_column_int64(stmt, 1);
+        sample.device = (uint16_t)sqlite3_column_int(stmt, 2);
+        for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+        {
+            if (sqlite3_column_type(stmt, 3 + ch) == SQLITE_NULL)
+                continue;
+            sample.values[ch] = sqlite3_column_double(stmt, 3 + ch);
+            sample.valid |= sensors_sample_channel_valid(ch);
+        }
+
+        if (first_seq < 0)
+        {
+            first_seq = sqlite3_column_int64(stmt, 0);
+            first_ms = sample.timestamp_ms;
+        }
+
+        if (sensors_codec_encode(&enc, &sample) < 0)
+            break; // cannot happen, the buffer fits a whole block
+    }
+    sqlite3_reset(stmt);
+
+    if (rc != SQLITE_DONE)
+    {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(self->db));
+        return -1;
+    }
+
+    self->archive_next_seq += self->policy.archive_block_samples;
+
+    if (first_seq < 0)
+        return 0; // rows lost (ring shrunk): nothing to archive
+
+    stmt = self->archive_stmt;
+    sqlite3_bind_int64(stmt, 1, first_seq);
+    sqlite3_bind_int64(stmt, 2, first_ms);
+    sqlite3_bind_int64(stmt, 3, enc.state.prev_ms);
+    sqlite3_bind_int64(stmt, 4, enc.state.count);
+    sqlite3_bind_blob(stmt, 5, self->archive_buf, sensors_codec_encoded_size(&enc), SQLITE_STATIC);
+
+    return sensors_db_step(self, stmt);
+}
+
+/*
+    Inside the flush transaction, before `seq` is written: seal the blocks
+    that are complete, so the row it overwrites is already archived (the
+    ring holds at least a block, see sensors_db_policy).
+*/
+static int sensors_db_archive_catch_up(struct sensors_db_sqlite *self, int64_t seq)
+{
+    while (seq - self->archive_next_seq >= self->policy.archive_block_samples)
+        if (sensors_db_archive_seal(self) < 0)
+            return -1;
+
+    return 0;
+}
+
+// First ring row not archived yet: after the last block, or the oldest row still in the ring
+static int sensors_db_archive_load(struct sensors_db_sqlite *self)
+{
+    sqlite3_stmt *stmt;
+
+    if (sensors_db_prepare(self,
+                           "SELECT MAX(IFNULL((SELECT MAX(first_seq + count) FROM SensorArchive), 0), "
+                           "IFNULL((SELECT MIN(seq) FROM SensorRing), ?1));",
+                           &stmt) < 0)
+        return -1;
+
+    sqlite3_bind_int64(stmt, 1, self->next_seq);
+
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW)
+        self->archive_next_seq = sqlite3_column_int64(stmt, 0);
+
+    sqlite3_finalize(stmt);
+
+    return (rc == SQLITE_ROW) ? 0 : -1;
+}
+
+static int sensors_db_archive_open(struct sensors_db_sqlite *self)
+{
+    const char *create_table_sql =
+        "CREATE TABLE IF NOT EXISTS SensorArchive ("
+        "first_seq INTEGER PRIMARY KEY, "
+        "first_ms INTEGER NOT NULL, "
+        "last_ms INTEGER NOT NULL, "
+        "count INTEGER NOT NULL, "
+        "data BLOB NOT NULL);"
+        "CREATE INDEX IF NOT EXISTS SensorArchive_time ON SensorArchive (last_ms);";
+
+    int rc = sqlite3_exec(self->db, create_table_sql, 0, 0, &self->err_msg);
+    if (rc != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", self->err_msg);
+        sqlite3_free(self->err_msg);
+        self->err_msg = NULL;
+        return -1;
+    }
+
+    self->archive_buf = (uint8_t *)malloc((size_t)self->policy.archive_block_samples * SENSORS_CODEC_MAX_SAMPLE_BYTES + 1);
+    if (!self->archive_buf)
+        return -1;
+
+    char seal_sql[512] = "SELECT seq, timestamp, device_id";
+    sensors_db_ring_columns(seal_sql, sizeof(seal_sql), ", %s");
+    sql_append(seal_sql, sizeof(seal_sql), " FROM SensorRing WHERE seq >= ?1 AND seq < ?2 ORDER BY seq;");
+
+    if (sensors_db_prepare(self, seal_sql, &self->seal_stmt) < 0 ||
+        sensors_db_prepare(self, "INSERT INTO SensorArchive VALUES (?1, ?2, ?3, ?4, ?5);", &self->archive_stmt) < 0)
+        return -1;
+
+    return sensors_db_archive_load(self);
+}
+
+int sensors_db_sqlite_archive_scan(const char *db_file, int64_t from_ms, int64_t to_ms, sensors_db_scan_cb cb, void *arg)
+{
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    int ret = 0;
+
+    if (!db_file || !cb)
+        return -1;
+
+    if (sqlite3_open_v2(db_file, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return -1;
+    }
+
+    if (sqlite3_prepare_v2(db, "SELECT count, data FROM SensorArchive WHERE last_ms >= ?1 AND first_ms <= ?2 ORDER BY first_seq;",
+                           -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error while preparing statement: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return -1;
+    }
+
+    sqlite3_bind_int64(stmt, 1, from_ms);
+    sqlite3_bind_int64(stmt, 2, to_ms);
+
+    while (ret == 0 && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        struct sensors_codec_decoder dec;
+        struct sensors_sample chunk[ARCHIVE_SCAN_CHUNK];
+        size_t n = 0;
+        int rc;
+
+        if (sensors_codec_decoder_init(&dec, (const uint8_t *)sqlite3_column_blob(stmt, 1), sqlite3_column_bytes(stmt, 1),
+                                       sqlite3_column_int64(stmt, 0)) < 0)
+            continue;
+
+        // Streaming decode, handed out in small chunks
+        while (ret == 0 && (rc = sensors_codec_decode(&dec, &chunk[n])) > 0)
+        {
+            if (chunk[n].timestamp_ms < from_ms || chunk[n].timestamp_ms > to_ms)
+                continue;
+
+            if (++n == ARCHIVE_SCAN_CHUNK)
+            {
+                ret = cb(chunk, n, arg);
+                n = 0;
+            }
+        }
+
+        if (ret == 0 && n > 0)
+            ret = cb(chunk, n, arg);
+    }
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    return ret;
+}
+
+/****************** Backend ******************/
+
+void *sensors_db_sqlite_open(const char *db_file, int data_limit, const struct sensors_db_policy *policy)
+{
+    struct sensors_db_policy default_policy = SENSORS_DB_POLICY_DEFAULT;
+
+    if (!policy)
+        policy = &default_policy;
+
+    if (data_limit <= 0 || policy->batch_samples <= 0 || policy->batch_seconds < 0)
+    {
+        return NULL;
+    }
+
+    if (policy->archive_block_samples < 0)
+    {
+        return NULL;
+    }
+
+    if (policy->archive_block_samples > data_limit)
+    {
+        fprintf(stderr, "Archive blocks of %d samples need a ring of at least as many rows (%d)\n",
+                policy->archive_block_samples, data_limit);
+        return NULL;
+    }
+
+    for (int tier_id = 0; tier_id < SENSORS_DB_ROLLUP_COUNT; tier_id++)
+        if (policy->rollup_retention[tier_id] < 0)
+    {
+        return NULL;
+    }
+
+    struct sensors_db_sqlite *sens_db = (struct sensors_db_sqlite *)calloc(1, sizeof(struct sensors_db_sqlite));
+
+    if (!sens_db)
+    {
+        return NULL;
+    }
+
+    // Open or create the SQLite database
+    int rc = sqlite3_open(db_file, &sens_db->db);
+    if (rc != SQLITE_OK)
+    {
+        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(sens_db->db));
+        goto err_close;
+    }
+
+    sens_db->policy = *policy;
+
+    if (sensors_db_apply_policy(sens_db) < 0)
+        goto err_close;
+
+    sens_db->pending = (struct sensors_db_pending *)calloc(policy->batch_samples, sizeof(struct sensors_db_pending));
+    if (!sens_db->pending)
+        goto err_close;
+
+    // Create the ring table, its ordered view and the seq index if they don't exist
+    char create_table_sql[1024] =
+        "CREATE TABLE IF NOT EXISTS SensorRing ("
+        "slot INTEGER PRIMARY KEY, "     // seq % data_limit
+        "seq INTEGER NOT NULL, "         // sample number, increases forever
+        "timestamp INTEGER NOT NULL, "   // Unix time, milliseconds
+        "device_id INTEGER NOT NULL";    // registry id, 0: unknown
+    sensors_db_ring_columns(create_table_sql, sizeof(create_table_sql), ", %s REAL");
+    sql_append(create_table_sql, sizeof(create_table_sql),
+               ");"
+               "CREATE INDEX IF NOT EXISTS SensorRing_seq ON SensorRing (seq);"
+               "CREATE TABLE IF NOT EXISTS SensorDevice ("
+               "id INTEGER PRIMARY KEY, "
+               "name TEXT NOT NULL, "
+               "driver TEXT NOT NULL, "
+               "bus TEXT NOT NULL, "
+               "address INTEGER NOT NULL, "
+               "mux_address INTEGER, "   // NULL: directly on the bus
+               "mux_channel INTEGER);");
+
+    // Recreated every time, so it follows the ring's columns
+    char create_view_sql[512] =
+        "DROP VIEW IF EXISTS SensorHistory;"
+        "CREATE VIEW SensorHistory AS "
+        "SELECT seq, timestamp, datetime(timestamp / 1000, 'unixepoch') AS datetime, device_id";
+    sensors_db_ring_columns(create_view_sql, sizeof(create_view_sql), ", %s");
+    sql_append(create_view_sql, sizeof(create_view_sql), " FROM SensorRing ORDER BY seq;");
+
+    rc = sqlite3_exec(sens_db->db, create_table_sql, 0, 0, &sens_db->err_msg);
+    if (rc != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error: %s\n", sens_db->err_msg);
+        sqlite3_free(sens_db->err_msg);
+        goto err_close;
+    }
+
+    sens_db->err_msg = NULL;
+
+    if (sensors_db_exec(sens_db, create_view_sql) < 0)
+        goto err_close;
+
+    sens_db->data_limit = data_limit;
+
+    // Capacity reduced since the last run: drop the slots that no longer exist
+    char shrink_sql[128];
+    snprintf(shrink_sql, sizeof(shrink_sql), "DELETE FROM SensorRing WHERE slot >= %d;", data_limit);
+    sqlite3_exec(sens_db->db, shrink_sql, 0, 0, NULL);
+
+    if (sensors_db_load_next_seq(sens_db) < 0)
+        goto err_close;
+
+    for (int tier_id = 0; tier_id < SENSORS_DB_ROLLUP_COUNT; tier_id++)
+        if (sensors_db_rollup_open(sens_db, tier_id) < 0)
+            goto err_close;
+
+    if (policy->archive_block_samples > 0 && sensors_db_archive_open(sens_db) < 0)
+        goto err_close;
+
+    // One UPSERT per sample overwrites the oldest slot, values bound as doubles (?5: first channel)
+    char upsert_sql[1024] = "INSERT INTO SensorRing (slot, seq, timestamp, device_id";
+    sensors_db_ring_columns(upsert_sql, sizeof(upsert_sql), ", %s");
+    sql_append(upsert_sql, sizeof(upsert_sql), ") VALUES (?1, ?2, ?3, ?4");
+    for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+        sql_append(upsert_sql, sizeof(upsert_sql), ", ?%d", 5 + ch);
+    sql_append(upsert_sql, sizeof(upsert_sql),
+               ") ON CONFLICT (slot) DO UPDATE SET "
+               "seq = excluded.seq, timestamp = excluded.timestamp, device_id = excluded.device_id");
+    sensors_db_ring_columns(upsert_sql, sizeof(upsert_sql), ", %s = excluded.%s");
+    sql_append(upsert_sql, sizeof(upsert_sql), ";");
+
+    if (sensors_db_prepare(sens_db, upsert_sql, &sens_db->upsert_stmt) < 0 ||
+        sensors_db_prepare(sens_db, "BEGIN IMMEDIATE;", &sens_db->begin_stmt) < 0 ||
+        sensors_db_prepare(sens_db, "COMMIT;", &sens_db->commit_stmt) < 0 ||
+        sensors_db_prepare(sens_db, "ROLLBACK;", &sens_db->rollback_stmt) < 0)
+        goto err_close;
+
+    return sens_db;
+
+err_close:
+    sqlite3_finalize(sens_db->upsert_stmt);
+    sqlite3_finalize(sens_db->begin_stmt);
+    sqlite3_finalize(sens_db->commit_stmt);
+    sqlite3_finalize(sens_db->rollback_stmt);
+    sensors_db_rollup_close(sens_db);
+    sqlite3_finalize(sens_db->seal_stmt);
+    sqlite3_finalize(sens_db->archive_stmt);
+    free(sens_db->archive_buf);
+    sqlite3_close(sens_db->db);
+    free(sens_db->pending);
+    free(sens_db);
+    return NULL;
+}
+
+static int sensors_db_sqlite_flush(void *backend);
+
+static int sensors_db_sqlite_flush_due(void *backend)
+{
+    struct sensors_db_sqlite *self = (struct sensors_db_sqlite *)backend;
+
+    if (self->pending_count == 0 || !sensors_db_batch_due(self))
+        return 0;
+
+    return sensors_db_sqlite_flush(self);
+}
+
+static int sensors_db_sqlite_store(void *backend, const struct sensors_sample *sample)
+{
+    struct sensors_db_sqlite *self = (struct sensors_db_sqlite *)backend;
+
+    // A previous commit failed and the buffer is still full: make room first
+    if (self->pending_count == self->policy.batch_samples && sensors_db_sqlite_flush(self) < 0)
+        return -1;
+
+    if (self->pending_count == 0)
+        clock_gettime(CLOCK_MONOTONIC, &self->pending_since);
+
+    struct sensors_db_pending *pending = &self->pending[self->pending_count++];
+    pending->seq = self->next_seq++;
+    pending->sample = *sample;
+
+    if (sample->valid != 0)
+        for (int tier_id = 0; tier_id < SENSORS_DB_ROLLUP_COUNT; tier_id++)
+            sensors_db_rollup_add(&self->rollups[tier_id], rollup_tiers[tier_id].period_ms, sample);
+
+    if (sensors_db_batch_due(self))
+        return sensors_db_sqlite_flush(self);
+
+    return 0;
+}
+
+static int sensors_db_sqlite_flush(void *backend)
+{
+    struct sensors_db_sqlite *self = (struct sensors_db_sqlite *)backend;
+
+    if (self->pending_count == 0)
+        return 0;
+
+    int64_t archive_next_seq = self->archive_next_seq; // restored if the transaction is rolled back
+
+    if (sensors_db_step(self, self->begin_stmt) < 0)
+        return -1;
+
+    for (int i = 0; i < self->pending_count; i++)
+    {
+        struct sensors_db_pending *pending = &self->pending[i];
+        const struct sensors_sample *sample = &pending->sample;
+
+        if (self->archive_buf && sensors_db_archive_catch_up(self, pending->seq) < 0)
+            goto err_rollback;
+
+        // Store new sensor data in the slot of the oldest one
+        sqlite3_bind_int64(self->upsert_stmt, 1, pending->seq % self->data_limit);
+        sqlite3_bind_int64(self->upsert_stmt, 2, pending->seq);
+        sqlite3_bind_int64(self->upsert_stmt, 3, sample->timestamp_ms);
+        sqlite3_bind_int(self->upsert_stmt, 4, sample->device);
+        for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+        {
+            if (sample->valid & sensors_sample_channel_valid(ch))
+                sqlite3_bind_double(self->upsert_stmt, 5 + ch, sample->values[ch]);
+            else
+                sqlite3_bind_null(self->upsert_stmt, 5 + ch);
+        }
+
+        if (sensors_db_step(self, self->upsert_stmt) < 0)
+            goto err_rollback;
+    }
+
+    if (sensors_db_rollup_flush(self) < 0 || sensors_db_step(self, self->commit_stmt) < 0)
+        goto err_rollback;
+
+    self->pending_count = 0;
+    for (int tier_id = 0; tier_id < SENSORS_DB_ROLLUP_COUNT; tier_id++)
+    {
+        struct sensors_db_rollup_tier *tier = &self->rollups[tier_id];
+
+        // Merged: the open buckets start over from nothing (the next sample sets their bucket again)
+        tier->closed_count = 0;
+        for (int i = 0; i < tier->open_count; i++)
+            tier->open[i].count = 0;
+    }
+
+    return 0;
+
+err_rollback:
+    // Samples stay buffered, the next store or flush retries them
+    sensors_db_step(self, self->rollback_stmt);
+    self->archive_next_seq = archive_next_seq;
+    return -1;
+}
+
+static void sensors_db_sqlite_close(void *backend)
+{
+    struct sensors_db_sqlite *self = (struct sensors_db_sqlite *)backend;
+
+    sensors_db_sqlite_flush(self);
+
+    sqlite3_finalize(self->upsert_stmt);
+    sqlite3_finalize(self->begin_stmt);
+    sqlite3_finalize(self->commit_stmt);
+    sqlite3_finalize(self->rollback_stmt);
+    sensors_db_rollup_close(self);
+    sqlite3_finalize(self->seal_stmt);
+    sqlite3_finalize(self->archive_stmt);
+    free(self->archive_buf);
+    sqlite3_close(self->db);
+    free(self->pending);
+    free(self);
+}
+
+static int sensors_db_sqlite_describe_device(void *backend, const struct sensors_device_info *info)
+{
+    struct sensors_db_sqlite *self = (struct sensors_db_sqlite *)backend;
+    sqlite3_stmt *stmt;
+
+    if (sqlite3_prepare_v2(self->db, "INSERT OR REPLACE INTO SensorDevice VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7);", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        fprintf(stderr, "SQL error while preparing statement: %s\n", sqlite3_errmsg(self->db));
+        return -1;
+    }
+
+    sqlite3_bind_int(stmt, 1, info->id);
+    sqlite3_bind_text(stmt, 2, info->name ? info->name : "", -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, info->driver ? info->driver : "", -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, info->bus ? info->bus : "", -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 5, info->address);
+    if (info->mux_address >= 0)
+    {
+        sqlite3_bind_int(stmt, 6, info->mux_address);
+        sqlite3_bind_int(stmt, 7, info->mux_channel);
+    }
+
+    int ret = sensors_db_step(self, stmt);
+    sqlite3_finalize(stmt);
+
+    return ret;
+}
+
+const struct sensors_db_backend_ops sensors_db_sqlite_ops = {
+    .name = "sqlite",
+    .store = sensors_db_sqlite_store,
+    .flush = sensors_db_sqlite_flush,
+    .flush_due = sensors_db_sqlite_flush_due,
+    .close = sensors_db_sqlite_close,
+    .describe_device = sensors_db_sqlite_describe_device,
+};
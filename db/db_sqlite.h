@@ -0,0 +1,150 @@
+#ifndef SENSORS_DB_SQLITE_H
+#define SENSORS_DB_SQLITE_H
+
+/*
+    SQLite storage backend.
+
+    Fixed-capacity retention: SensorRing has `data_limit` slots, sample
+    number `seq` goes to slot seq % data_limit, so every insert is a single
+    UPSERT whatever the capacity. Readers use the SensorHistory view
+    (oldest first). Only the compensated values are stored, invalid
+    channels as NULL, with the device_id of the sensor they came from;
+    SensorDevice maps the ids to the registry entries.
+*/
+
+#include "db.h"
+#include "codec.h"
+#include <sqlite3.h> // SQLite library
+
+// PRAGMA synchronous level
+enum sensors_db_sync
+{
+    SENSORS_DB_SYNC_OFF = 0,    // no fsync, a power cut can corrupt the database
+    SENSORS_DB_SYNC_NORMAL = 1, // WAL: fsync at checkpoints only, a power cut may lose the last commits
+    SENSORS_DB_SYNC_FULL = 2,   // fsync on every commit
+};
+
+/*
+    Rollup tiers: SensorRollup1m/1h/1d hold min/max/sum/last and a count
+    per channel for each device and period (buckets keyed by device_id
+    and their start, Unix ms, UTC), `count` being the number of samples. They are updated from
+    in-memory accumulators as samples arrive, never by aggregating the raw
+    rows: each commit merges what arrived since the previous one into the
+    rows (min of mins, sum of sums...), so a bucket written again, even
+    after the clock stepped back into it, only grows. Each channel only
+    folds in the samples where it is valid.
+*/
+enum sensors_db_rollup
+{
+    SENSORS_DB_ROLLUP_MINUTE = 0,
+    SENSORS_DB_ROLLUP_HOUR,
+    SENSORS_DB_ROLLUP_DAY,
+    SENSORS_DB_ROLLUP_COUNT
+};
+
+/*
+    Durability policy: samples are buffered in memory and committed in a
+    single transaction once `batch_samples` are pending or the oldest one is
+    `batch_seconds` old, whichever comes first. A batch of 1 commits every
+    sample on its own.
+*/
+struct sensors_db_policy
+{
+    bool wal; // journal_mode=WAL instead of the rollback journal
+    enum sensors_db_sync synchronous;
+    int batch_samples;
+    int batch_seconds;
+
+    // Buckets kept per rollup tier, 0 keeps them forever
+    int rollup_retention[SENSORS_DB_ROLLUP_COUNT];
+
+    /*
+        Samples per compressed archive block, 0: no archive, rows leaving the
+        ring are dropped. Blocks are written once, when the ring holds a
+        whole block of rows not archived yet (it must be at least that big).
+    */
+    int archive_block_samples;
+};
+
+// About one minute of samples (1 Hz BMP280 + 0.1 Hz HTU21D) per commit; minutes for a week, hours for 2 years; 5 min archive blocks
+#define SENSORS_DB_POLICY_DEFAULT                                                                  \
+    {.wal = true, .synchronous = SENSORS_DB_SYNC_NORMAL, .batch_samples = 66, .batch_seconds = 60, \
+     .rollup_retention = {7 * 24 * 60, 2 * 366 * 24, 0}, .archive_block_samples = 330}
+
+struct sensors_db_pending
+{
+    int64_t seq;
+    struct sensors_sample sample;
+};
+
+struct sensors_db_rollup_row
+{
+    uint16_t device;
+    int64_t bucket; // period start, Unix ms
+    int64_t count; // samples, any channel valid
+    int64_t channel_count[SENSORS_DB_CHANNELS];
+    double min[SENSORS_DB_CHANNELS];
+    double max[SENSORS_DB_CHANNELS];
+    double sum[SENSORS_DB_CHANNELS];
+    double last[SENSORS_DB_CHANNELS];
+};
+
+struct sensors_db_rollup_tier
+{
+    // Bucket being accumulated since the last commit, one per device seen (count 0: nothing yet)
+    struct sensors_db_rollup_row *open;
+    int open_count;
+    int open_size;
+
+    // Buckets finished since the last commit (at most one per pending sample)
+    struct sensors_db_rollup_row *closed;
+    int closed_count;
+
+    sqlite3_stmt *upsert_stmt;
+    sqlite3_stmt *retention_stmt;
+};
+
+struct sensors_db_sqlite
+{
+    sqlite3 *db;
+    char *err_msg;
+    int data_limit;
+    int64_t next_seq;
+
+    struct sensors_db_policy policy;
+
+    // Samples not committed yet
+    struct sensors_db_pending *pending;
+    int pending_count;
+    struct timespec pending_since; // CLOCK_MONOTONIC, when the oldest pending sample was queued
+
+    struct sensors_db_rollup_tier rollups[SENSORS_DB_ROLLUP_COUNT];
+
+    // Archive blocks, sealed from the ring rows starting at archive_next_seq
+    int64_t archive_next_seq; // oldest ring row not archived yet
+    uint8_t *archive_buf;
+    sqlite3_stmt *seal_stmt;
+    sqlite3_stmt *archive_stmt;
+
+    // Prepared once in sensors_db_sqlite_open(), reset and re-bound for every sample
+    sqlite3_stmt *upsert_stmt;
+    sqlite3_stmt *begin_stmt;
+    sqlite3_stmt *commit_stmt;
+    sqlite3_stmt *rollback_stmt;
+};
+
+extern const struct sensors_db_backend_ops sensors_db_sqlite_ops;
+
+// Open or create the database, returns the backend handle or NULL
+void *sensors_db_sqlite_open(const char *db_file, int data_limit, const struct sensors_db_policy *policy);
+
+/*
+    Scan the archived samples with from_ms <= timestamp <= to_ms from
+    `db_file` (own read-only connection), decoding one block at a time.
+    The newest samples are only in SensorRing until a block is sealed,
+    and the newest block's samples are usually still there too.
+    Returns 0, the callback's non-zero value, or -1 on error.
+*/
+int sensors_db_sqlite_archive_scan(const char *db_file, int64_t from_ms, int64_t to_ms, sensors_db_scan_cb cb, void *arg);
+
+#endif /* SENSORS_DB_SQLITE_H */
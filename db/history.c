@@ -0,0 +1,231 @@
+#include "history.h"
+#include <stdlib.h>
+#include <string.h>
+
+/****************** Segment tree ******************/
+
+static void agg_merge(struct sensors_history_agg *dst, const struct sensors_history_agg *src)
+{
+    if (src->count == 0)
+        return;
+
+    if (dst->count == 0)
+    {
+        *dst = *src;
+        return;
+    }
+
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+static void node_merge(struct sensors_history_node *dst, const struct sensors_history_node *src)
+{
+    for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+        agg_merge(&dst->channels[ch], &src->channels[ch]);
+}
+
+// Recompute the ancestors of a leaf
+static void tree_update(struct sensors_history *self, size_t node)
+{
+    for (node /= 2; node >= 1; node /= 2)
+    {
+        self->nodes[node] = self->nodes[2 * node];
+        node_merge(&self->nodes[node], &self->nodes[2 * node + 1]);
+    }
+}
+
+// Merge leaves [first, last] (leaf indices, no wrap) into `out`
+static void tree_query(struct sensors_history *self, size_t first, size_t last, struct sensors_history_node *out)
+{
+    size_t l = first + self->buckets;
+    size_t r = last + self->buckets + 1;
+
+    for (; l < r; l /= 2, r /= 2)
+    {
+        if (l & 1)
+            node_merge(out, &self->nodes[l++]);
+        if (r & 1)
+            node_merge(out, &self->nodes[--r]);
+    }
+}
+
+// Slide the window so that `bucket` is the newest one, emptying the recycled leaves
+static void tree_advance(struct sensors_history *self, int64_t bucket)
+{
+    if (self->newest_bucket < 0 || bucket - self->newest_bucket >= (int64_t)self->buckets)
+    {
+        memset(self->nodes, 0, 2 * self->buckets * sizeof(struct sensors_history_node));
+    }
+    else
+    {
+        for (int64_t b = self->newest_bucket + 1; b <= bucket; b++)
+        {
+            size_t leaf = self->buckets + (size_t)(b % (int64_t)self->buckets);
+
+            memset(&self->nodes[leaf], 0, sizeof(struct sensors_history_node));
+            tree_update(self, leaf);
+        }
+    }
+
+    self->newest_bucket = bucket;
+}
+
+/****************** Public API ******************/
+
+struct sensors_history *sensors_history_create(int64_t bucket_ms, size_t buckets, size_t recent)
+{
+    if (bucket_ms <= 0 || buckets == 0 || recent == 0)
+        return NULL;
+
+    struct sensors_history *self = (struct sensors_history *)calloc(1, sizeof(struct sensors_history));
+    if (!self)
+        return NULL;
+
+    size_t size = 1;
+    while (size < buckets)
+        size *= 2;
+
+    self->buckets = size;
+    self->bucket_ms = bucket_ms;
+    self->newest_bucket = -1;
+    self->recent_size = recent;
+
+    self->nodes = (struct sensors_history_node *)calloc(2 * size, sizeof(struct sensors_history_node));
+    self->recent = (struct sensors_sample *)calloc(recent, sizeof(struct sensors_sample));
+
+    if (!self->nodes || !self->recent || pthread_rwlock_init(&self->lock, NULL) != 0)
+    {
+        free(self->nodes);
+        free(self->recent);
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void sensors_history_add(struct sensors_history *self, const struct sensors_sample *sample)
+{
+    if (!self || !sample || sample->timestamp_ms < 0)
+        return;
+
+    int64_t bucket = sample->timestamp_ms / self->bucket_ms;
+
+    pthread_rwlock_wrlock(&self->lock);
+
+    self->recent[self->recent_next] = *sample;
+    self->recent_next = (self->recent_next + 1) % self->recent_size;
+    if (self->recent_count < self->recent_size)
+        self->recent_count++;
+
+    if (bucket > self->newest_bucket)
+        tree_advance(self, bucket);
+
+    if (bucket > self->newest_bucket - (int64_t)self->buckets)
+    {
+        size_t leaf = self->buckets + (size_t)(bucket % (int64_t)self->buckets);
+
+        for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+        {
+            if (!(sample->valid & sensors_sample_channel_valid(ch)))
+                continue;
+
+            struct sensors_history_agg one = {.count = 1, .min = sample->values[ch], .max = sample->values[ch], .sum = sample->values[ch]};
+            agg_merge(&self->nodes[leaf].channels[ch], &one);
+        }
+
+        tree_update(self, leaf);
+    }
+
+    pthread_rwlock_unlock(&self->lock);
+}
+
+int sensors_history_query(struct sensors_history *self, int64_t from_ms, int64_t to_ms,
+                          struct sensors_history_stats stats[SENSORS_DB_CHANNELS])
+{
+    struct sensors_history_node total = {0};
+
+    if (!self || !stats || from_ms > to_ms)
+        return -1;
+
+    pthread_rwlock_rdlock(&self->lock);
+
+    // Clip to the window held by the tree
+    int64_t first = (from_ms < 0 ? 0 : from_ms) / self->bucket_ms;
+    int64_t last = (to_ms < 0 ? -1 : to_ms / self->bucket_ms);
+    int64_t oldest = self->newest_bucket - (int64_t)self->buckets + 1;
+
+    if (first < oldest)
+        first = oldest;
+    if (last > self->newest_bucket)
+        last = self->newest_bucket;
+
+    if (self->newest_bucket >= 0 && first <= last)
+    {
+        size_t l = (size_t)(first % (int64_t)self->buckets);
+        size_t r = (size_t)(last % (int64_t)self->buckets);
+
+        if (l <= r)
+        {
+            tree_query(self, l, r, &total);
+        }
+        else
+        {
+            // Range wraps around the circular leaves
+            tree_query(self, l, self->buckets - 1, &total);
+            tree_query(self, 0, r, &total);
+        }
+    }
+
+    pthread_rwlock_unlock(&self->lock);
+
+    uint32_t samples = 0;
+    for (int ch = 0; ch < SENSORS_DB_CHANNELS; ch++)
+    {
+        const struct sensors_history_agg *agg = &total.channels[ch];
+
+        stats[ch].count = agg->count;
+        stats[ch].min = agg->count ? agg->min : 0;
+        stats[ch].max = agg->count ? agg->max : 0;
+        stats[ch].mean = agg->count ? (float)(agg->sum / agg->count) : 0;
+
+        if (agg->count > samples)
+            samples = agg->count;
+    }
+
+    return (int)samples;
+}
+
+size_t sensors_history_recent(struct sensors_history *self, struct sensors_sample *out, size_t max)
+{
+    if (!self || !out)
+        return 0;
+
+    pthread_rwlock_rdlock(&self->lock);
+
+    size_t n = max < self->recent_count ? max : self->recent_count;
+    size_t start = (self->recent_next + self->recent_size - n) % self->recent_size;
+
+    for (size_t i = 0; i < n; i++)
+        out[i] = self->recent[(start + i) % self->recent_size];
+
+    pthread_rwlock_unlock(&self->lock);
+
+    return n;
+}
+
+void sensors_history_destroy(struct sensors_history *self)
+{
+    if (!self)
+        return;
+
+    pthread_rwlock_destroy(&self->lock);
+    free(self->nodes);
+    free(self->recent);
+    free(self);
+}
@@ -0,0 +1,77 @@
+#ifndef SENSORS_HISTORY_H
+#define SENSORS_HISTORY_H
+
+/*
+    In-memory history kept next to the sensors_db, so the display, alerting
+    or any API can look at the past without touching the store:
+    - a ring of the most recent samples
+    - a segment tree over fixed-width time buckets (a circular window of
+      `buckets` buckets) answering count/min/max/mean for any time range
+      in O(log n), updated in O(log n) per sample
+    Ranges are resolved at bucket granularity: a bucket counts if it
+    overlaps the range. Channels are aggregated across devices: with two
+    sensors of the same kind, a range covers both (the per-device view is
+    in the store's rollups). Thread-safe: one writer, any number of readers.
+*/
+
+#include "db.h"
+#include <pthread.h>
+
+struct sensors_history_stats
+{
+    uint32_t count; // valid samples in the range
+    float min;
+    float max;
+    float mean;
+};
+
+// Aggregate of one channel over a bucket or a range of buckets
+struct sensors_history_agg
+{
+    uint32_t count;
+    float min;
+    float max;
+    double sum;
+};
+
+struct sensors_history_node
+{
+    struct sensors_history_agg channels[SENSORS_DB_CHANNELS];
+};
+
+struct sensors_history
+{
+    pthread_rwlock_t lock;
+
+    // Recent samples, oldest overwritten first
+    struct sensors_sample *recent;
+    size_t recent_size;
+    size_t recent_count;
+    size_t recent_next;
+
+    // Segment tree: nodes[1] is the root, leaves at nodes[buckets + (bucket number % buckets)]
+    struct sensors_history_node *nodes;
+    size_t buckets; // power of two
+    int64_t bucket_ms;
+    int64_t newest_bucket; // bucket number (timestamp / bucket_ms) of the newest sample, -1: empty
+};
+
+/*
+    `bucket_ms` wide buckets, `buckets` of them (rounded up to a power of
+    two) and the last `recent` samples. Returns NULL on failure.
+*/
+struct sensors_history *sensors_history_create(int64_t bucket_ms, size_t buckets, size_t recent);
+
+// Samples older than the bucket window only go to the recent ring
+void sensors_history_add(struct sensors_history *self, const struct sensors_sample *sample);
+
+// Per-channel stats over [from_ms, to_ms]; returns the largest per-channel count (0: no data) or -1
+int sensors_history_query(struct sensors_history *self, int64_t from_ms, int64_t to_ms,
+                          struct sensors_history_stats stats[SENSORS_DB_CHANNELS]);
+
+// Copy up to `max` of the most recent samples, oldest first; returns how many
+size_t sensors_history_recent(struct sensors_history *self, struct sensors_sample *out, size_t max);
+
+void sensors_history_destroy(struct sensors_history *self);
+
+#endif /* SENSORS_HISTORY_H */
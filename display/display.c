@@ -1,14 +1,19 @@
 /*
  * LCD 16x2 (HD44780 controller) over I²C (PCF8574 backpack)
  *
- * This example follows the HD44780 datasheet closely:
+ * Follows the HD44780 datasheet:
  * - 4-bit mode initialization (Section 10 "Initializing by Instruction")
- * - Uses PCF8574 I²C I/O expander (address typically 0x27 or 0x3F)
- * - Displays "Hello" and "World!" alternately.
+ * - PCF8574 I²C I/O expander (address typically 0x27 or 0x3F)
+ *
+ * display_print()/display_clear() only store the text and wake the event
+ * loop, which renders each line into a 16-cell frame, diffs it against a
+ * shadow copy of the DDRAM and sends just the changed cells (one cursor
+ * move per run of them). Lines longer than 16 characters scroll on a loop
+ * timer, in software or with the controller's display shift.
  *
  * Wiring (via PCF8574 backpack):
  *   P0 → RS (Register Select)
- *   P1 → RW (Read/Write, always 0 for write)
+ *   P1 → RW (Read/Write, 1 only while reading the busy flag)
  *   P2 → EN (Enable pulse)
  *   P3 → Backlight (1 = on)
  *   P4 → D4
@@ -26,16 +31,21 @@
 #include <stdatomic.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <time.h>
 #include "i2c.h"
+#include "event_loop.h"
 #include "display/low_level/low_level.h"
 
-#define PCF8574_I2C_ADDR 0x27
-
 #define MAX_CHARS 16
-#define SCROLL_DELAY_US 500000
+#define MAX_LINES 2
+#define DDRAM_COLS 40 /* HD44780 holds 40 characters per line */
+#define SCROLL_DELAY_NS (500LL * 1000 * 1000)
 
-typedef struct
+struct display
 {
+    struct display_ll ll;
+
     char line1[MAX_PRINT_SIZE];
     char line2[MAX_PRINT_SIZE];
 
@@ -45,39 +55,73 @@ typedef struct
     _Atomic bool l1_update_needed;
     _Atomic bool l2_update_needed;
 
-    _Atomic bool running;
+    enum display_scroll_mode scroll_mode;
+
+    /* Shadow framebuffer: what is currently in DDRAM, and how far the window is shifted */
+    char shadow[MAX_LINES][DDRAM_COLS];
+    int shift;
+    bool hw_scrolling;
+    int cursor_line; /* where the next character lands (-1: unknown) */
+    int cursor_col;
 
     pthread_mutex_t lock;
-    pthread_t thread;
-} display_t;
 
-static display_t display;
+    /* Rendering runs on the event loop thread */
+    struct event_loop *loop;
+    struct event_source wakeup; /* new content */
+    struct event_source scroll; /* next scroll step, armed only while a line scrolls */
+};
 
-/* Print a static (non-scrolling) line */
-static void display_print_line(uint8_t line, const char *src, int offset)
+/* Render a `width`-character window of `src` starting at `offset`, padded with spaces */
+static void display_render_line(char *dst, const char *src, int offset, int width)
 {
-    display_ll_set_cursor(line);
+    int len = strlen(src);
 
-    for (int i = 0; i < MAX_CHARS; i++)
+    for (int i = 0; i < width; i++)
+        dst[i] = (offset + i < len) ? src[offset + i] : ' ';
+}
+
+/*
+    Send only the cells that differ from the shadow framebuffer.
+    The cursor is moved only when there is a gap between two dirty cells,
+    consecutive ones rely on the controller auto-increment.
+*/
+static void display_flush_line(struct display *self, uint8_t line, const char *frame, int width)
+{
+    for (int col = 0; col < width; col++)
     {
-        char c = src[offset + i];
+        if (self->shadow[line][col] == frame[col])
+            continue;
+
+        if (self->cursor_line != line || self->cursor_col != col)
+            display_ll_set_position(&self->ll, line, col);
 
-        if (c == '\0') // pad with spaces
-            c = ' ';
+        display_ll_data(&self->ll, frame[col]);
+        self->shadow[line][col] = frame[col];
 
-        display_ll_data(c);
+        self->cursor_line = line;
+        self->cursor_col = col + 1;
     }
 }
 
+/* Print a static (non-scrolling) line */
+static void display_print_line(struct display *self, uint8_t line, const char *src, int offset)
+{
+    char frame[MAX_CHARS];
+
+    display_render_line(frame, src, offset, MAX_CHARS);
+    display_flush_line(self, line, frame, MAX_CHARS);
+}
+
 /* Circular scrolling with doubled buffer */
-__attribute__((unused)) static void display_print_circular(uint8_t line, const char *src, int *offset)
+__attribute__((unused)) static void display_print_circular(struct display *self, uint8_t line, const char *src, int *offset)
 {
     int len = strlen(src);
 
     /* No need to scroll short text */
     if (len <= MAX_CHARS)
     {
-        display_print_line(line, src, 0);
+        display_print_line(self, line, src, 0);
         return;
     }
 
@@ -85,22 +129,19 @@ __attribute__((unused)) static void display_print_circular(uint8_t line, const c
     static char buf[2 * MAX_PRINT_SIZE];
     snprintf(buf, sizeof(buf), "%s%s", src, src);
 
-    display_ll_set_cursor(line);
-
-    for (int i = 0; i < MAX_CHARS; i++)
-        display_ll_data(buf[*offset + i]);
+    display_flush_line(self, line, buf + *offset, MAX_CHARS);
 
     /* Advance offset circularly */
     *offset = (*offset + 1) % len;
 }
 
 /* Rollback scrolling */
-static void display_print_rollback(uint8_t line, const char *src, int *offset)
+static void display_print_rollback(struct display *self, uint8_t line, const char *src, int *offset)
 {
     int len = strlen(src);
 
     /* Print substring */
-    display_print_line(line, src,
+    display_print_line(self, line, src,
                        (len > MAX_CHARS) ? *offset : 0);
 
     /* Scroll */
@@ -108,83 +149,258 @@ static void display_print_rollback(uint8_t line, const char *src, int *offset)
         *offset = (*offset + 1) % (len - MAX_CHARS + 1);
 }
 
-static void *display_thread(void *arg)
+/* Undo any hardware shift so that DDRAM column 0 is visible again */
+static void display_unshift(struct display *self)
+{
+    if (self->shift == 0)
+        return;
+
+    display_ll_home(&self->ll);
+    self->shift = 0;
+    self->cursor_line = 0;
+    self->cursor_col = 0;
+}
+
+static bool display_line_blank(const char *str)
+{
+    return str[strspn(str, " ")] == '\0';
+}
+
+/*
+    Hardware scrolling shifts both lines at once, so it is only usable when
+    every line either needs scrolling and fits in DDRAM, or is blank.
+*/
+static bool display_hw_scroll_usable(struct display *self)
 {
-    (void)arg;
+    const char *lines[MAX_LINES] = {self->line1, self->line2};
+    bool scrolling = false;
+
+    if (self->scroll_mode != DISPLAY_SCROLL_HARDWARE)
+        return false;
 
-    while (atomic_load(&display.running))
+    for (int i = 0; i < MAX_LINES; i++)
     {
-        pthread_mutex_lock(&display.lock);
-
-        /* Reset offsets when content changes */
-        if (atomic_exchange(&display.l1_update_needed, false))
-        {
-            display.offset1 = 0;
-            display_ll_clear();
-        }
-        else if (atomic_exchange(&display.l2_update_needed, false))
-        {
-            display.offset2 = 0;
-            display_ll_clear();
-        }
-
-        /* Print both lines + Scroll */
-        display_print_rollback(0, display.line1, &display.offset1);
-        display_print_rollback(1, display.line2, &display.offset2);
-
-        pthread_mutex_unlock(&display.lock);
-
-        usleep(SCROLL_DELAY_US);
+        int len = strlen(lines[i]);
+
+        if (len > DDRAM_COLS)
+            return false;
+        if (len > MAX_CHARS)
+            scrolling = true;
+        else if (!display_line_blank(lines[i]))
+            return false;
     }
 
-    return NULL;
+    return scrolling;
 }
 
-void display_create(struct I2cBus *i2c_bus)
+/*
+    Hardware scroll: load the text into DDRAM once, then advance the visible
+    window with a single display-shift command per tick.
+*/
+static void display_scroll_hardware(struct display *self, bool reload)
 {
-    memset(&display, 0, sizeof(display));
-    pthread_mutex_init(&display.lock, NULL);
+    if (reload || !self->hw_scrolling)
+    {
+        char frame[DDRAM_COLS];
+
+        display_unshift(self);
 
-    display_ll_init(i2c_bus, PCF8574_I2C_ADDR);
+        display_render_line(frame, self->line1, 0, DDRAM_COLS);
+        display_flush_line(self, 0, frame, DDRAM_COLS);
+        display_render_line(frame, self->line2, 0, DDRAM_COLS);
+        display_flush_line(self, 1, frame, DDRAM_COLS);
 
-    atomic_store(&display.running, true);
-    pthread_create(&display.thread, NULL, display_thread, NULL);
+        self->hw_scrolling = true;
+        return;
+    }
+
+    display_ll_shift_left(&self->ll);
+    self->shift = (self->shift + 1) % DDRAM_COLS;
 }
 
-void display_destroy(void)
+static bool display_needs_scroll(struct display *self)
 {
-    atomic_store(&display.running, false);
-    pthread_join(display.thread, NULL);
-    pthread_mutex_destroy(&display.lock);
+    return strlen(self->line1) > MAX_CHARS || strlen(self->line2) > MAX_CHARS;
 }
 
-void display_print(const char *str, uint8_t line)
+static void display_render(struct display *self)
 {
-    if (!str || line > 1)
-        return;
+    /* Reset offsets when content changes (no clear: the diff overwrites stale cells) */
+    bool changed = false;
 
-    pthread_mutex_lock(&display.lock);
+    if (atomic_exchange(&self->l1_update_needed, false))
+    {
+        self->offset1 = 0;
+        changed = true;
+    }
+    if (atomic_exchange(&self->l2_update_needed, false))
+    {
+        self->offset2 = 0;
+        changed = true;
+    }
 
-    if (line == 0)
+    if (display_hw_scroll_usable(self))
     {
-        strncpy(display.line1, str, MAX_PRINT_SIZE - 1);
-        atomic_store(&display.l1_update_needed, true);
+        display_scroll_hardware(self, changed);
     }
     else
     {
-        strncpy(display.line2, str, MAX_PRINT_SIZE - 1);
-        atomic_store(&display.l2_update_needed, true);
+        /* Software fallback: print both lines + Scroll */
+        display_unshift(self);
+        self->hw_scrolling = false;
+
+        display_print_rollback(self, 0, self->line1, &self->offset1);
+        display_print_rollback(self, 1, self->line2, &self->offset2);
     }
 
-    pthread_mutex_unlock(&display.lock);
+    display_ll_flush(&self->ll);
+}
+
+/*
+    Render the pending content or the next scroll step, at low bus priority
+    so the LCD refresh never delays a sensor read queued by another thread.
+    Then arm the next step only while a line actually scrolls.
+*/
+static void display_update(struct display *self)
+{
+    pthread_mutex_lock(&self->lock);
+
+    i2c_set_thread_priority(I2C_PRIO_LOW);
+    display_render(self);
+    i2c_set_thread_priority(I2C_PRIO_HIGH);
+
+    if (display_needs_scroll(self))
+        event_timer_arm_in(&self->scroll, SCROLL_DELAY_NS, 0);
+    else
+        event_timer_disarm(&self->scroll);
+
+    pthread_mutex_unlock(&self->lock);
 }
 
-void display_clear(void)
+static void display_event(struct event_source *src, uint32_t events)
 {
-    pthread_mutex_lock(&display.lock);
-    display.line1[0] = '\0';
-    display.line2[0] = '\0';
-    atomic_store(&display.l1_update_needed, true);
-    atomic_store(&display.l2_update_needed, true);
-    pthread_mutex_unlock(&display.lock);
+    (void)events;
+
+    display_update((struct display *)src->arg);
+}
+
+struct display *display_create(struct I2cBus *i2c_bus, uint8_t addr, struct event_loop *loop)
+{
+    if (!i2c_bus || !loop)
+        return NULL;
+
+    struct display *self = (struct display *)calloc(1, sizeof(struct display));
+    if (!self)
+        return NULL;
+
+    pthread_mutex_init(&self->lock, NULL);
+
+    display_ll_init(&self->ll, i2c_bus, addr);
+
+    /* display_ll_init() clears the screen and homes the cursor */
+    memset(self->shadow, ' ', sizeof(self->shadow));
+    self->shift = 0;
+    self->scroll_mode = DISPLAY_SCROLL_HARDWARE;
+    self->cursor_line = 0;
+    self->cursor_col = 0;
+
+    self->loop = loop;
+    self->wakeup.cb = display_event;
+    self->wakeup.arg = self;
+    self->wakeup.fd = -1;
+    self->scroll.cb = display_event;
+    self->scroll.arg = self;
+    self->scroll.fd = -1;
+
+    if (event_loop_add_wakeup(loop, &self->wakeup) < 0 || event_loop_add_timer(loop, &self->scroll) < 0)
+    {
+        event_loop_remove(loop, &self->wakeup);
+        pthread_mutex_destroy(&self->lock);
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void display_destroy(struct display *self)
+{
+    if (!self)
+        return;
+
+    event_loop_remove(self->loop, &self->wakeup);
+    event_loop_remove(self->loop, &self->scroll);
+
+    /* Pending content is still shown on shutdown (e.g. a final display_clear()) */
+    pthread_mutex_lock(&self->lock);
+    i2c_set_thread_priority(I2C_PRIO_LOW);
+    display_render(self);
+    i2c_set_thread_priority(I2C_PRIO_HIGH);
+    pthread_mutex_unlock(&self->lock);
+
+    pthread_mutex_destroy(&self->lock);
+    free(self);
+}
+
+void display_set_scroll_mode(struct display *self, enum display_scroll_mode mode)
+{
+    if (!self)
+        return;
+
+    pthread_mutex_lock(&self->lock);
+    self->scroll_mode = mode;
+    atomic_store(&self->l1_update_needed, true);
+    pthread_mutex_unlock(&self->lock);
+
+    event_wakeup(&self->wakeup);
+}
+
+bool display_set_busy_polling(struct display *self, bool enable)
+{
+    if (!self)
+        return false;
+
+    pthread_mutex_lock(&self->lock);
+    bool ret = display_ll_set_busy_polling(&self->ll, enable);
+    pthread_mutex_unlock(&self->lock);
+
+    return ret;
+}
+
+void display_print(struct display *self, const char *str, uint8_t line)
+{
+    if (!self || !str || line > 1)
+        return;
+
+    pthread_mutex_lock(&self->lock);
+
+    char *dst = (line == 0) ? self->line1 : self->line2;
+
+    /* Same text again: nothing to wake the event loop for */
+    bool changed = strncmp(dst, str, MAX_PRINT_SIZE - 1) != 0;
+    if (changed)
+    {
+        strncpy(dst, str, MAX_PRINT_SIZE - 1);
+        atomic_store((line == 0) ? &self->l1_update_needed : &self->l2_update_needed, true);
+    }
+
+    pthread_mutex_unlock(&self->lock);
+
+    if (changed)
+        event_wakeup(&self->wakeup);
+}
+
+void display_clear(struct display *self)
+{
+    if (!self)
+        return;
+
+    pthread_mutex_lock(&self->lock);
+    self->line1[0] = '\0';
+    self->line2[0] = '\0';
+    atomic_store(&self->l1_update_needed, true);
+    atomic_store(&self->l2_update_needed, true);
+    pthread_mutex_unlock(&self->lock);
+
+    event_wakeup(&self->wakeup);
 }
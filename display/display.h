@@ -6,17 +6,51 @@
     connected through a PCF8574 I²C backpack.
 */
 #include <stdint.h>
+#include <stdbool.h>
 #include "i2c.h"
+#include "event_loop.h"
 
 #define MAX_PRINT_SIZE 128
 
-void display_create(struct I2cBus *i2c_bus);
-void display_destroy(void);
+/*
+    How lines longer than 16 characters scroll:
+    - ROLLBACK: software, the 16 visible characters are re-sent every step
+    - HARDWARE: the text is loaded once in the 40-character DDRAM lines and
+      the controller shifts the window (one command per step). Both lines
+      shift together, so this is used only while no static text is shown;
+      otherwise, and for text over 40 characters, it falls back to ROLLBACK.
+*/
+enum display_scroll_mode
+{
+    DISPLAY_SCROLL_ROLLBACK,
+    DISPLAY_SCROLL_HARDWARE,
+};
+
+#define DISPLAY_DEFAULT_ADDR 0x27 /* PCF8574, 0x3F on PCF8574A backpacks */
+
+struct display;
+
+/*
+    Screen updates run on `loop`: display_print()/display_clear() can be
+    called from any thread and only wake the loop, which sends the changed
+    cells (and the scroll steps, on a timer) over the bus.
+    Returns NULL on failure.
+*/
+struct display *display_create(struct I2cBus *i2c_bus, uint8_t addr, struct event_loop *loop);
+
+/* Show the pending content one last time, detach from the loop and free */
+void display_destroy(struct display *self);
+
+/* Select the scrolling strategy (default: DISPLAY_SCROLL_HARDWARE) */
+void display_set_scroll_mode(struct display *self, enum display_scroll_mode mode);
+
+/* Poll the HD44780 busy flag instead of fixed delays (returns false if not wired) */
+bool display_set_busy_polling(struct display *self, bool enable);
 
 /* Print a string on line 0 or 1 */
-void display_print(const char *str, uint8_t line);
+void display_print(struct display *self, const char *str, uint8_t line);
 
 /* Clear whole display */
-void display_clear(void);
+void display_clear(struct display *self);
 
 #endif /* PI_HOME_SENSORS_DISPLAY_H */
\ No newline at end of file
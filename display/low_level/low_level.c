@@ -7,7 +7,7 @@
  *
  * Wiring (via PCF8574 backpack):
  *   P0 → RS (Register Select)
- *   P1 → RW (Read/Write, always 0 for write)
+ *   P1 → RW (Read/Write, 1 only while reading the busy flag)
  *   P2 → EN (Enable pulse)
  *   P3 → Backlight (1 = on)
  *   P4 → D4
@@ -23,6 +23,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <time.h>
 #include "i2c.h"
 
 /* LCD command definitions (from HD44780U datasheet, Table 6) */
@@ -70,100 +71,279 @@
 #define PIN_BL 0x08 /* P3 (backlight) */
 #define BACKLIGHT 0x08
 
+/* Status read back (RS=0, RW=1): busy flag + address counter */
+#define BUSY_FLAG 0x80
+#define BUSY_TIMEOUT_US 10000
+#define BUSY_BACKOFF_MIN 8    /* long waits on delays after a failed read-back */
+#define BUSY_BACKOFF_MAX 1024
+#define BUSY_MARGIN_US 100    /* on top of the observed busy time (+25 %) */
+
 /* Timing constants */
-#define ENABLE_PULSE_US 500
-#define COMMAND_DELAY_US 2000
+#define CLEAR_DELAY_US 2000 /* clear/home: 1.52 ms max */
+#define EXEC_TIME_NS 37000  /* every other instruction: 37 us max */
+
+/*
+    Bus clock of the I2C adapter (Raspberry Pi default: 100 kHz).
+    One byte on the wire is 9 clocks (8 data + ACK), this is what paces
+    the EN pulses and instruction spacing instead of usleep().
+*/
+#define I2C_BUS_HZ 100000
+#define I2C_BYTE_NS (9 * 1000000000LL / I2C_BUS_HZ)
+
+
+/* Send everything queued so far in a single I2C write */
+void display_ll_flush(struct display_ll *self)
+{
+    if (self->stream_len == 0)
+        return;
+
+    i2c_write(self->i2c_bus, self->i2c_addr, self->stream, self->stream_len);
+    self->stream_len = 0;
+}
+
+static uint64_t display_ll_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+    Read BF + address counter: D4-D7 released high (PCF8574 quasi-bidirectional
+    inputs), RW=1, then two EN strobes reading one nibble each. The whole
+    sequence is one combined I2C transaction.
+*/
+static int display_ll_read_status(struct display_ll *self, uint8_t *status)
+{
+    uint8_t idle = 0xF0 | PIN_RW | BACKLIGHT;
+    uint8_t strobe[2] = {idle, idle | PIN_EN};
+    uint8_t release = idle;
+    uint8_t high, low;
+
+    struct I2cMsg msgs[5] = {
+        {.addr = self->i2c_addr, .flags = I2C_MSG_WRITE, .len = 2, .buf = strobe},
+        {.addr = self->i2c_addr, .flags = I2C_MSG_READ, .len = 1, .buf = &high},
+        {.addr = self->i2c_addr, .flags = I2C_MSG_WRITE, .len = 2, .buf = strobe},
+        {.addr = self->i2c_addr, .flags = I2C_MSG_READ, .len = 1, .buf = &low},
+        {.addr = self->i2c_addr, .flags = I2C_MSG_WRITE, .len = 1, .buf = &release},
+    };
+
+    if (i2c_transfer(self->i2c_bus, msgs, 5) < 0)
+        return -1;
+
+    self->port = idle;
+    *status = (high & 0xF0) | (low >> 4);
+    return 0;
+}
 
-typedef struct
+/*
+    Poll BF until the controller is ready; -1 if it cannot be read or never
+    clears. `elapsed_us` (may be NULL) gets how long it stayed busy.
+*/
+static int display_ll_poll_busy(struct display_ll *self, unsigned timeout_us, unsigned *elapsed_us)
 {
-    struct I2cBus *i2c_bus;
-    uint8_t i2c_addr;
-} display_ll_ll_t;
+    uint64_t start = display_ll_now_us();
+    uint64_t now = start;
+    uint8_t status;
+
+    do
+    {
+        if (display_ll_read_status(self, &status) < 0)
+            return -1;
+
+        now = display_ll_now_us();
+        if (!(status & BUSY_FLAG))
+        {
+            if (elapsed_us)
+                *elapsed_us = (unsigned)(now - start);
+            return 0;
+        }
+    } while (now < start + timeout_us);
 
-static display_ll_ll_t display_ll_ll;
+    return -1;
+}
 
-/* Toggle EN (Enable) to latch 4-bit data */
-static void display_ll_toggle_enable(uint8_t data)
+/*
+    Wait for a long instruction (clear/home) to complete: continue as soon as
+    BF clears when read-back works. Otherwise sleep what earlier polls showed
+    this controller needs (plus a margin, at most the datasheet delay), and
+    poll again after a backoff that doubles while read-back keeps failing.
+*/
+static void display_ll_wait_ready(struct display_ll *self, unsigned fallback_us)
 {
-    i2c_write(display_ll_ll.i2c_bus, display_ll_ll.i2c_addr, &data, sizeof(data));
+    unsigned elapsed_us;
+
+    if (self->busy_polling && self->busy_backoff > 0)
+    {
+        self->busy_backoff--;
+    }
+    else if (self->busy_polling)
+    {
+        if (display_ll_poll_busy(self, BUSY_TIMEOUT_US, &elapsed_us) == 0)
+        {
+            if (elapsed_us > self->busy_observed_us)
+                self->busy_observed_us = elapsed_us;
+            self->busy_backoff_next = BUSY_BACKOFF_MIN;
+            return;
+        }
 
-    data |= PIN_EN;
-    i2c_write(display_ll_ll.i2c_bus, display_ll_ll.i2c_addr, &data, sizeof(data));
-    usleep(ENABLE_PULSE_US);
+        fprintf(stderr, "LCD: busy flag not readable, delays for the next %u waits\n", self->busy_backoff_next);
+        self->busy_backoff = self->busy_backoff_next;
+        if (self->busy_backoff_next < BUSY_BACKOFF_MAX)
+            self->busy_backoff_next *= 2;
+    }
 
-    data &= ~PIN_EN;
-    i2c_write(display_ll_ll.i2c_bus, display_ll_ll.i2c_addr, &data, sizeof(data));
-    usleep(ENABLE_PULSE_US);
+    unsigned delay_us = fallback_us;
+    if (self->busy_observed_us > 0)
+    {
+        unsigned learned_us = self->busy_observed_us + self->busy_observed_us / 4 + BUSY_MARGIN_US;
+        if (learned_us < delay_us)
+            delay_us = learned_us;
+    }
+
+    usleep(delay_us);
+}
+
+static void display_ll_stream_push(struct display_ll *self, uint8_t data)
+{
+    self->stream[self->stream_len++] = data;
+    self->port = data;
 }
 
-/* Send 4 bits (nibble) to LCD */
-static void display_ll_write_nibble(uint8_t nibble, uint8_t mode)
+/*
+    Queue one 4-bit transfer: data/RS set up with EN low (only when they
+    change), EN high, EN low. Each byte holds the outputs for one byte time
+    on the bus (90 us at 100 kHz), far above the 450 ns EN pulse width.
+*/
+static void display_ll_write_nibble(struct display_ll *self, uint8_t nibble, uint8_t mode)
 {
     /* Combine 4 data bits (D4–D7) with control bits */
     uint8_t data = (nibble & 0xF0) | mode | BACKLIGHT;
-    i2c_write(display_ll_ll.i2c_bus, display_ll_ll.i2c_addr, &data, sizeof(data));
-    display_ll_toggle_enable(data);
+
+    if (self->stream_len + 3 > DISPLAY_LL_STREAM_SIZE)
+        display_ll_flush(self);
+
+    if (self->port != data)
+        display_ll_stream_push(self, data);
+
+    display_ll_stream_push(self, data | PIN_EN);
+    display_ll_stream_push(self, data); /* falling edge latches the nibble */
 }
 
-/* Send full byte (split into two nibbles) */
-static void display_ll_write_byte(uint8_t value, uint8_t mode)
+/* Queue a full byte (split into two nibbles) */
+static void display_ll_write_byte(struct display_ll *self, uint8_t value, uint8_t mode)
 {
     /* High nibble first */
-    display_ll_write_nibble(value & 0xF0, mode);
+    display_ll_write_nibble(self, value & 0xF0, mode);
     /* Then low nibble */
-    display_ll_write_nibble((value << 4) & 0xF0, mode);
-    usleep(COMMAND_DELAY_US);
+    display_ll_write_nibble(self, (value << 4) & 0xF0, mode);
+
+    /* Keep EN low long enough for the instruction to execute (no-op at 100 kHz) */
+    for (int i = 0; i < self->exec_pad; i++)
+    {
+        if (self->stream_len == DISPLAY_LL_STREAM_SIZE)
+            display_ll_flush(self);
+        display_ll_stream_push(self, self->port);
+    }
 }
 
 /* LCD command */
-static void display_ll_command(uint8_t cmd)
+static void display_ll_command(struct display_ll *self, uint8_t cmd)
 {
-    display_ll_write_byte(cmd, 0x00);
+    display_ll_write_byte(self, cmd, 0x00);
 }
 
 /* Initialize LCD in 4-bit mode (datasheet Figure 24) */
-void display_ll_init(struct I2cBus *i2c_bus, uint8_t i2c_addr)
+void display_ll_init(struct display_ll *self, struct I2cBus *i2c_bus, uint8_t i2c_addr)
 {
-    display_ll_ll.i2c_bus = i2c_bus;
-    display_ll_ll.i2c_addr = i2c_addr;
+    self->i2c_bus = i2c_bus;
+    self->i2c_addr = i2c_addr;
+    self->stream_len = 0;
+    self->port = 0;
+    self->busy_polling = false;
+    self->busy_observed_us = 0;
+    self->busy_backoff = 0;
+    self->busy_backoff_next = BUSY_BACKOFF_MIN;
+
+    /* The next EN rise is at least one byte away, pad only the remainder */
+    self->exec_pad = (EXEC_TIME_NS + I2C_BYTE_NS - 1) / I2C_BYTE_NS - 1;
 
     // usleep(50000); // Wait > 40 ms after power-on
 
     /* Set 8-bit mode three times (function set) */
-    display_ll_write_nibble(0x30, 0x00);
+    display_ll_write_nibble(self, 0x30, 0x00);
+    display_ll_flush(self);
     usleep(4500);
-    display_ll_write_nibble(0x30, 0x00);
+    display_ll_write_nibble(self, 0x30, 0x00);
+    display_ll_flush(self);
     usleep(150);
-    display_ll_write_nibble(0x30, 0x00);
+    display_ll_write_nibble(self, 0x30, 0x00);
+    display_ll_flush(self);
     usleep(150);
 
     /* Switch to 4-bit mode */
-    display_ll_write_nibble(0x20, 0x00);
+    display_ll_write_nibble(self, 0x20, 0x00);
+    display_ll_flush(self);
     usleep(150);
 
     /* Now we can send full commands in 4-bit mode */
-    display_ll_command(LCD_FUNCTION_SET | LCD_4BIT_MODE | LCD_2LINE | LCD_5x8DOTS);
-    display_ll_command(LCD_DISPLAY_CONTROL | LCD_DISPLAY_ON | LCD_CURSOR_OFF | LCD_BLINK_OFF);
-    display_ll_command(LCD_CLEAR_DISPLAY);
+    display_ll_command(self, LCD_FUNCTION_SET | LCD_4BIT_MODE | LCD_2LINE | LCD_5x8DOTS);
+    display_ll_command(self, LCD_DISPLAY_CONTROL | LCD_DISPLAY_ON | LCD_CURSOR_OFF | LCD_BLINK_OFF);
+    display_ll_clear(self);
 }
 
 /* Set cursor to line (1 or 2) */
-void display_ll_set_cursor(uint8_t line)
+void display_ll_set_cursor(struct display_ll *self, uint8_t line)
 {
     uint8_t address = (line == 0) ? 0x80 : 0xC0;
-    display_ll_command(address);
+    display_ll_command(self, address);
+}
+
+/* Set cursor to a given column (0-39) of line 0 or 1 */
+void display_ll_set_position(struct display_ll *self, uint8_t line, uint8_t col)
+{
+    uint8_t address = ((line == 0) ? 0x00 : 0x40) + col;
+    display_ll_command(self, LCD_SET_DDRAM_ADDR | address);
 }
 
 /* LCD data (character) */
-void display_ll_data(uint8_t data)
+void display_ll_data(struct display_ll *self, uint8_t data)
+{
+    display_ll_write_byte(self, data, PIN_RS);
+}
+
+/* Shift the visible window one column to the right (text moves left) */
+void display_ll_shift_left(struct display_ll *self)
+{
+    display_ll_command(self, LCD_CURSOR_SHIFT | LCD_DISPLAY_MOVE | LCD_MOVE_LEFT);
+}
+
+/* Return home: cursor to 0 and display shift undone */
+void display_ll_home(struct display_ll *self)
 {
-    display_ll_write_byte(data, PIN_RS);
+    display_ll_command(self, LCD_RETURN_HOME);
+    display_ll_flush(self);
+    /* Same execution time as clear */
+    display_ll_wait_ready(self, CLEAR_DELAY_US);
 }
 
 /* Clear the display */
-void display_ll_clear(void)
+void display_ll_clear(struct display_ll *self)
 {
-    display_ll_command(LCD_CLEAR_DISPLAY);
+    display_ll_command(self, LCD_CLEAR_DISPLAY);
+    display_ll_flush(self);
     /* Clearing the display takes a bit longer */
-    usleep(2000);
+    display_ll_wait_ready(self, CLEAR_DELAY_US);
+}
+
+/* Enable BF read-back if the backpack wires RW (probed first) */
+bool display_ll_set_busy_polling(struct display_ll *self, bool enable)
+{
+    display_ll_flush(self);
+
+    self->busy_polling = enable && display_ll_poll_busy(self, BUSY_TIMEOUT_US, NULL) == 0;
+    self->busy_backoff = 0;
+    self->busy_backoff_next = BUSY_BACKOFF_MIN;
+
+    return self->busy_polling;
 }
@@ -11,16 +11,68 @@
 #include <stdbool.h>
 #include "i2c.h"
 
+/* Largest single write sent to the PCF8574 (one line update fits easily) */
+#define DISPLAY_LL_STREAM_SIZE 128
+
+/* One HD44780 behind a PCF8574 */
+struct display_ll
+{
+    struct I2cBus *i2c_bus;
+    uint8_t i2c_addr;
+
+    /*
+        Stream encoder: the RS/EN/data sequence of a run of instructions,
+        the PCF8574 latches each byte of a multi-byte write in turn.
+    */
+    uint8_t stream[DISPLAY_LL_STREAM_SIZE];
+    size_t stream_len;
+    uint8_t port; /* last byte queued, i.e. PCF8574 outputs once flushed */
+    int exec_pad; /* idle bytes needed after an instruction at this bus clock */
+
+    bool busy_polling;          /* RW wired and readable: poll BF instead of sleeping */
+    unsigned busy_observed_us;  /* longest clear/home seen clearing BF, 0: none yet */
+    unsigned busy_backoff;      /* read-back failed: long waits left on delays before polling again */
+    unsigned busy_backoff_next; /* length of the next backoff (doubles while read-back keeps failing) */
+};
+
+/*
+    Commands and characters are encoded into a buffered RS/EN/data byte
+    stream and only hit the bus on display_ll_flush() (or when the buffer
+    fills up), so a whole line update is a single I2C write.
+*/
+
 /* Initialize LCD in 4-bit mode (datasheet Figure 24) */
-void display_ll_init(struct I2cBus *i2c_bus, uint8_t i2c_addr);
+void display_ll_init(struct display_ll *self, struct I2cBus *i2c_bus, uint8_t i2c_addr);
 
 /* Set cursor to line (1 or 2) */
-void display_ll_set_cursor(uint8_t line);
+void display_ll_set_cursor(struct display_ll *self, uint8_t line);
+
+/* Set cursor to a given column (0-39) of line 0 or 1 */
+void display_ll_set_position(struct display_ll *self, uint8_t line, uint8_t col);
 
 /* LCD data (character) */
-void display_ll_data(uint8_t data);
+void display_ll_data(struct display_ll *self, uint8_t data);
+
+/* Shift the visible window one column to the right (text moves left) */
+void display_ll_shift_left(struct display_ll *self);
+
+/* Return home: cursor to 0 and display shift undone (flushes, then waits) */
+void display_ll_home(struct display_ll *self);
+
+/* Clear the display (flushes, then waits for the controller) */
+void display_ll_clear(struct display_ll *self);
+
+/*
+    Optional busy-flag read-back (needs RW wired to P1): long instructions
+    continue as soon as BF clears instead of sleeping the worst case.
+    Probes the controller first; returns whether polling is now active.
+    If read-back stops working it sleeps instead, for the longest busy time
+    seen so far plus a margin (datasheet delay if none), and tries polling
+    again after an exponential backoff.
+*/
+bool display_ll_set_busy_polling(struct display_ll *self, bool enable);
 
-/* Clear the display */
-void display_ll_clear(void);
+/* Send the queued byte stream in one I2C write */
+void display_ll_flush(struct display_ll *self);
 
 #endif /* PI_HOME_SENSORS_DISPLAY_LOW_LEVEL_H */
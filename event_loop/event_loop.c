@@ -0,0 +1,296 @@
+#include "event_loop.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+
+#define NSEC_PER_SEC 1000000000LL
+
+static struct timespec ns_to_ts(int64_t ns)
+{
+    struct timespec ts = {.tv_sec = ns / NSEC_PER_SEC, .tv_nsec = ns % NSEC_PER_SEC};
+    return ts;
+}
+
+static int event_loop_watch(struct event_loop *self, struct event_source *src, enum event_source_type type,
+                            int fd, uint32_t events)
+{
+    struct epoll_event ev = {.events = events, .data.ptr = src};
+
+    src->type = type;
+    src->fd = fd;
+    src->count = 0;
+    src->signo = 0;
+    src->loop = self;
+
+    if (epoll_ctl(self->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        perror("Failed to watch event source");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+    Consume what made the fd readable, so it does not fire again for the
+    same event. False if there is nothing left (e.g. a timer re-armed by an
+    earlier callback of the same batch): the callback is skipped.
+*/
+static bool event_source_drain(struct event_source *src)
+{
+    switch (src->type)
+    {
+    case EVENT_SOURCE_TIMER:
+    case EVENT_SOURCE_WAKEUP:
+        return read(src->fd, &src->count, sizeof(src->count)) == sizeof(src->count);
+
+    case EVENT_SOURCE_SIGNAL:
+    {
+        struct signalfd_siginfo info;
+
+        if (read(src->fd, &info, sizeof(info)) != sizeof(info))
+            return false;
+
+        src->signo = (int)info.ssi_signo;
+        return true;
+    }
+
+    case EVENT_SOURCE_FD:
+        break;
+    }
+
+    return true;
+}
+
+/****************** Public API ******************/
+
+int event_loop_init(struct event_loop *self)
+{
+    if (!self)
+        return -1;
+
+    memset(self, 0, sizeof(*self));
+
+    self->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (self->epfd < 0)
+    {
+        perror("Failed to create epoll instance");
+        return -1;
+    }
+
+    return 0;
+}
+
+int event_loop_add_fd(struct event_loop *self, struct event_source *src, int fd, uint32_t events)
+{
+    if (!self || !src || !src->cb || fd < 0)
+        return -1;
+
+    return event_loop_watch(self, src, EVENT_SOURCE_FD, fd, events);
+}
+
+int event_loop_add_timer(struct event_loop *self, struct event_source *src)
+{
+    if (!self || !src || !src->cb)
+        return -1;
+
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0)
+    {
+        perror("Failed to create timerfd");
+        return -1;
+    }
+
+    if (event_loop_watch(self, src, EVENT_SOURCE_TIMER, fd, EPOLLIN) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+int event_loop_add_wakeup(struct event_loop *self, struct event_source *src)
+{
+    if (!self || !src || !src->cb)
+        return -1;
+
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0)
+    {
+        perror("Failed to create eventfd");
+        return -1;
+    }
+
+    if (event_loop_watch(self, src, EVENT_SOURCE_WAKEUP, fd, EPOLLIN) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+int event_loop_add_signals(struct event_loop *self, struct event_source *src, const sigset_t *mask)
+{
+    if (!self || !src || !src->cb || !mask)
+        return -1;
+
+    int err = pthread_sigmask(SIG_BLOCK, mask, NULL);
+    if (err != 0)
+    {
+        errno = err;
+        perror("Failed to block signals");
+        return -1;
+    }
+
+    int fd = signalfd(-1, mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0)
+    {
+        perror("Failed to create signalfd");
+        return -1;
+    }
+
+    if (event_loop_watch(self, src, EVENT_SOURCE_SIGNAL, fd, EPOLLIN) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+int event_loop_remove(struct event_loop *self, struct event_source *src)
+{
+    if (!self || !src || src->loop != self)
+        return -1;
+
+    epoll_ctl(self->epfd, EPOLL_CTL_DEL, src->fd, NULL);
+
+    // Drop its pending event from the batch being dispatched
+    for (int i = 0; i < self->ready_count; i++)
+        if (self->ready[i].data.ptr == src)
+            self->ready[i].data.ptr = NULL;
+
+    if (src->type != EVENT_SOURCE_FD)
+        close(src->fd);
+
+    src->fd = -1;
+    src->loop = NULL;
+
+    return 0;
+}
+
+int event_timer_arm_at(struct event_source *src, const struct timespec *at, int64_t interval_ns)
+{
+    if (!src || src->type != EVENT_SOURCE_TIMER || !at || interval_ns < 0)
+        return -1;
+
+    struct itimerspec spec = {.it_value = *at, .it_interval = ns_to_ts(interval_ns)};
+
+    // An all-zero it_value would disarm: a deadline at 0 is just long gone
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+        spec.it_value.tv_nsec = 1;
+
+    return timerfd_settime(src->fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+int event_timer_arm_in(struct event_source *src, int64_t delay_ns, int64_t interval_ns)
+{
+    if (!src || src->type != EVENT_SOURCE_TIMER || delay_ns <= 0 || interval_ns < 0)
+        return -1;
+
+    struct itimerspec spec = {.it_value = ns_to_ts(delay_ns), .it_interval = ns_to_ts(interval_ns)};
+
+    return timerfd_settime(src->fd, 0, &spec, NULL);
+}
+
+int event_timer_disarm(struct event_source *src)
+{
+    if (!src || src->type != EVENT_SOURCE_TIMER)
+        return -1;
+
+    struct itimerspec spec = {0};
+
+    return timerfd_settime(src->fd, 0, &spec, NULL);
+}
+
+void event_wakeup(struct event_source *src)
+{
+    uint64_t one = 1;
+
+    if (!src || src->type != EVENT_SOURCE_WAKEUP || src->fd < 0)
+        return;
+
+    // Only fails (EAGAIN) when the counter is saturated: a wakeup is pending anyway
+    if (write(src->fd, &one, sizeof(one)) < 0)
+        return;
+}
+
+int event_loop_run(struct event_loop *self)
+{
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+
+    if (!self)
+        return -1;
+
+    self->running = true;
+
+    while (self->running)
+    {
+        int n = epoll_wait(self->epfd, events, EVENT_LOOP_MAX_EVENTS, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            perror("epoll_wait failed");
+            self->running = false;
+            return -1;
+        }
+
+        self->waits++;
+        self->ready = events;
+        self->ready_count = n;
+
+        for (int i = 0; i < n; i++)
+        {
+            struct event_source *src = (struct event_source *)events[i].data.ptr;
+
+            if (!src)
+                continue; // removed by an earlier callback of this batch
+
+            if (!event_source_drain(src))
+                continue;
+
+            self->dispatched++;
+            src->cb(src, events[i].events);
+        }
+
+        self->ready = NULL;
+        self->ready_count = 0;
+    }
+
+    return 0;
+}
+
+void event_loop_stop(struct event_loop *self)
+{
+    if (self)
+        self->running = false;
+}
+
+void event_loop_destroy(struct event_loop *self)
+{
+    if (!self || self->epfd < 0)
+        return;
+
+    close(self->epfd);
+    self->epfd = -1;
+}
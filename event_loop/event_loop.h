@@ -0,0 +1,104 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+/*
+    Single-threaded event loop: every I/O source of the process (timers,
+    signals, cross-thread wakeups, sockets) is a file descriptor watched
+    by one epoll_wait(), and its callback runs on the loop thread.
+    - timer: timerfd on CLOCK_MONOTONIC, one-shot or periodic, absolute
+      or relative; `count` gets the expirations since the last callback
+    - signal: signalfd; the signals are blocked instead of handled, so no
+      code runs in signal context and shutdown is an ordinary callback
+    - wakeup: eventfd, event_wakeup() is safe from any thread (and from a
+      signal handler); `count` gets the coalesced wakeups
+    - fd: any pollable descriptor owned by the caller (sockets, ...)
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/epoll.h>
+
+struct event_source;
+
+// Runs on the loop thread; `events` is the EPOLL* mask reported for the fd
+typedef void (*event_cb)(struct event_source *src, uint32_t events);
+
+enum event_source_type
+{
+    EVENT_SOURCE_FD,
+    EVENT_SOURCE_TIMER,
+    EVENT_SOURCE_SIGNAL,
+    EVENT_SOURCE_WAKEUP,
+};
+
+struct event_source
+{
+    event_cb cb;
+    void *arg;
+
+    // Managed by the loop
+    enum event_source_type type;
+    int fd;
+    uint64_t count; // timer expirations / wakeups behind this callback
+    int signo;      // signal sources: the signal received
+    struct event_loop *loop;
+};
+
+#define EVENT_LOOP_MAX_EVENTS 16
+
+struct event_loop
+{
+    int epfd;
+    bool running;
+
+    // Batch being dispatched, so a callback can remove any source safely
+    struct epoll_event *ready;
+    int ready_count;
+
+    uint64_t waits;      // epoll_wait() returns
+    uint64_t dispatched; // callbacks run
+};
+
+int event_loop_init(struct event_loop *self);
+
+/*
+    Sources: the caller fills `cb` and `arg` and keeps the memory alive
+    until event_loop_remove(). All return 0 or -1 (errno set).
+*/
+int event_loop_add_fd(struct event_loop *self, struct event_source *src, int fd, uint32_t events);
+int event_loop_add_timer(struct event_loop *self, struct event_source *src); // created disarmed
+int event_loop_add_wakeup(struct event_loop *self, struct event_source *src);
+
+/*
+    Block the signals of `mask` in the calling thread and deliver them to
+    `src`. Threads inherit the mask: call it before starting any other
+    thread, otherwise the signals may still hit one of those.
+*/
+int event_loop_add_signals(struct event_loop *self, struct event_source *src, const sigset_t *mask);
+
+// Stop watching `src` and close its fd (not for EVENT_SOURCE_FD, the caller owns it)
+int event_loop_remove(struct event_loop *self, struct event_source *src);
+
+// First expiration at the absolute CLOCK_MONOTONIC time `at`, then every `interval_ns` (0: one-shot)
+int event_timer_arm_at(struct event_source *src, const struct timespec *at, int64_t interval_ns);
+
+// Same, first expiration `delay_ns` from now (must be > 0)
+int event_timer_arm_in(struct event_source *src, int64_t delay_ns, int64_t interval_ns);
+
+int event_timer_disarm(struct event_source *src);
+
+// Any thread, async-signal-safe: run the wakeup callback on the loop thread
+void event_wakeup(struct event_source *src);
+
+// Dispatch events until event_loop_stop(); returns 0, or -1 if epoll_wait() failed
+int event_loop_run(struct event_loop *self);
+
+// Loop thread (from a callback): return from event_loop_run() after the current batch
+void event_loop_stop(struct event_loop *self);
+
+// Close the epoll fd (sources still registered are left to their owners)
+void event_loop_destroy(struct event_loop *self);
+
+#endif /* EVENT_LOOP_H */
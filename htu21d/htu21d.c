@@ -2,14 +2,13 @@
 #include "crc.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <linux/i2c-dev.h>
 #include <sys/ioctl.h>
 #include "i2c.h"
 
-#define HTU21D_I2C_ADDR 0x40
-
 #define TRIGGER_TEMP_HOLD 0xE3
 #define TRIGGER_HUMID_HOLD 0xE5
 
@@ -22,9 +21,67 @@
 #define TEMPERATURE_MEASUREMENT 0x00
 #define HUMIDITY_MEASUREMENT 0x02
 
-#define HTU21D_MEAS_DELAY_US 100000 // 100ms max measurement time
+// User register and reset
+#define WRITE_USER_REG 0xE6
+#define READ_USER_REG 0xE7
+#define SOFT_RESET 0xFE
+
+#define USER_REG_RES_MASK 0x81
+#define USER_REG_END_OF_BATTERY 0x40
+#define USER_REG_HEATER 0x04
+
+#define HTU21D_SOFT_RESET_US 15000 // datasheet: < 15 ms
+
+// Polling once the expected conversion time has elapsed
+#define HTU21D_POLL_INTERVAL_US 1000
+#define HTU21D_POLL_RETRIES 20
+
+// Datasheet max conversion times, per resolution mode
+static void htu21d_conversion_times(enum htu21d_resolution resolution, uint32_t *temp_us, uint32_t *humid_us)
+{
+    switch (resolution)
+    {
+    case HTU21D_RES_RH8_T12:
+        *temp_us = 13000;
+        *humid_us = 3000;
+        break;
+    case HTU21D_RES_RH10_T13:
+        *temp_us = 25000;
+        *humid_us = 5000;
+        break;
+    case HTU21D_RES_RH11_T11:
+        *temp_us = 7000;
+        *humid_us = 8000;
+        break;
+    case HTU21D_RES_RH12_T14:
+    default:
+        *temp_us = 50000;
+        *humid_us = 16000;
+        break;
+    }
+}
+
+static int htu21d_read_user_register(struct htu21d *self, uint8_t *reg)
+{
+    uint8_t command = READ_USER_REG;
+
+    return i2c_write_read(self->i2c_bus, self->addr, &command, 1, reg, 1);
+}
+
+// Read-modify-write: reserved bits 3-5 must keep their value
+static int htu21d_update_user_register(struct htu21d *self, uint8_t mask, uint8_t value)
+{
+    uint8_t reg;
+
+    if (htu21d_read_user_register(self, &reg) < 0)
+        return -1;
 
-struct htu21d *htu21d_init(struct I2cBus *i2c_bus)
+    uint8_t config[2] = {WRITE_USER_REG, (reg & ~mask) | (value & mask)};
+
+    return i2c_write(self->i2c_bus, self->addr, config, 2);
+}
+
+struct htu21d *htu21d_init(struct I2cBus *i2c_bus, uint8_t addr)
 {
     if (!i2c_bus)
     {
@@ -39,10 +96,101 @@ struct htu21d *htu21d_init(struct I2cBus *i2c_bus)
     }
 
     ret->i2c_bus = i2c_bus;
+    ret->addr = addr;
+    ret->converting = false;
+
+    // Soft reset: back to the default user register (RH 12-bit / T 14-bit, heater off)
+    uint8_t command = SOFT_RESET;
+    if (i2c_write(i2c_bus, addr, &command, 1) < 0)
+    {
+        perror("Failed to reset HTU21D");
+        free(ret);
+        return NULL;
+    }
+    usleep(HTU21D_SOFT_RESET_US);
+
+    ret->resolution = HTU21D_RES_RH12_T14;
+    htu21d_conversion_times(ret->resolution, &ret->temp_conv_us, &ret->humid_conv_us);
 
     return ret;
 }
 
+int htu21d_set_resolution(struct htu21d *self, enum htu21d_resolution resolution)
+{
+    if (!self || !self->i2c_bus || self->converting)
+        return -1;
+
+    if (htu21d_update_user_register(self, USER_REG_RES_MASK, resolution) < 0)
+    {
+        perror("HTU21D: failed to set resolution");
+        return -1;
+    }
+
+    self->resolution = resolution;
+    htu21d_conversion_times(resolution, &self->temp_conv_us, &self->humid_conv_us);
+
+    return 0;
+}
+
+int htu21d_set_heater(struct htu21d *self, bool enable)
+{
+    if (!self || !self->i2c_bus || self->converting)
+        return -1;
+
+    return htu21d_update_user_register(self, USER_REG_HEATER, enable ? USER_REG_HEATER : 0);
+}
+
+int htu21d_end_of_battery(struct htu21d *self)
+{
+    uint8_t reg;
+
+    if (!self || !self->i2c_bus || self->converting)
+        return -1;
+
+    if (htu21d_read_user_register(self, &reg) < 0)
+        return -1;
+
+    return (reg & USER_REG_END_OF_BATTERY) ? 1 : 0;
+}
+
+/****************** Result decoding ******************/
+int htu21d_decode(const uint8_t data[HTU21D_RESULT_SIZE], enum htu21d_channel channel, struct htu21d_measurement *res)
+{
+    res->is_valid = false;
+    res->value = 0;
+    res->raw = (data[0] << 8) | data[1];
+
+    if (compute_crc8(data, 2) != data[2])
+        return -1;
+
+    uint16_t raw = (data[0] << 8) | (data[1] & MEASUREMENT_MASK);
+
+    if (channel == HTU21D_TEMPERATURE)
+        res->value = -46.85 + (175.72 * raw) / 65536.0;
+    else
+        res->value = -6.0 + (125.0 * raw) / 65536.0;
+
+    res->is_valid = true;
+    return 0;
+}
+
+int htu21d_command_channel(uint8_t command, enum htu21d_channel *channel)
+{
+    switch (command)
+    {
+    case TRIGGER_TEMP_HOLD:
+    case TRIGGER_TEMP_NO_HOLD:
+        *channel = HTU21D_TEMPERATURE;
+        return 0;
+    case TRIGGER_HUMID_HOLD:
+    case TRIGGER_HUMID_NO_HOLD:
+        *channel = HTU21D_HUMIDITY;
+        return 0;
+    default:
+        return -1;
+    }
+}
+
 /****************** Hold master commands ******************/
 static struct htu21d_measurement get_measurement_hold(struct htu21d *self, uint8_t command)
 {
@@ -54,33 +202,19 @@ static struct htu21d_measurement get_measurement_hold(struct htu21d *self, uint8
         goto err_out;
     }
 
-    if (i2c_read_register(self->i2c_bus, HTU21D_I2C_ADDR, command, data, 3) < 0)
+    /* Command + read in one transaction: the sensor stretches SCL until the conversion is done */
+    if (i2c_write_read(self->i2c_bus, self->addr, &command, 1, data, 3) < 0)
     {
         goto err_out;
     }
 
-    uint8_t computed_crc = compute_crc8(data, 2);
+    enum htu21d_channel channel = ((data[1] & MEASUREMENT_TYPE_MASK) == TEMPERATURE_MEASUREMENT) ? HTU21D_TEMPERATURE : HTU21D_HUMIDITY;
 
-    if (computed_crc != data[2])
+    if (htu21d_decode(data, channel, &res) < 0)
     {
-        printf("Wrong CRC: computed:%d | received:%d", computed_crc, data[2]);
+        printf("Wrong CRC: computed:%d | received:%d", compute_crc8(data, 2), data[2]);
         goto err_out;
     }
-
-    uint16_t raw = (data[0] << 8) | (data[1] & MEASUREMENT_MASK);
-
-    if ((data[1] & MEASUREMENT_TYPE_MASK) == TEMPERATURE_MEASUREMENT)
-    {
-        // Temperature measurement
-        res.is_valid = true;
-        res.value = -46.85 + (175.72 * raw) / 65536.0;
-    }
-    else
-    {
-        // Humidity measurement
-        res.is_valid = true;
-        res.value = -6.0 + (125.0 * raw) / 65536.0;
-    }
     return res;
 
 err_out:
@@ -99,59 +233,126 @@ struct htu21d_measurement htu21d_read_humidity_hold(struct htu21d *self)
 }
 
 /****************** Non-hold master commands ******************/
-static struct htu21d_measurement get_measurement_no_hold(struct htu21d *self, uint8_t command, uint8_t meas_type)
+static void timespec_add_us(struct timespec *ts, long us)
 {
-    struct htu21d_measurement res = {.is_valid = false, .value = 0};
-    uint8_t data[3];
+    ts->tv_nsec += (us % 1000000) * 1000;
+    ts->tv_sec += us / 1000000 + ts->tv_nsec / 1000000000;
+    ts->tv_nsec %= 1000000000;
+}
 
+int htu21d_start_conversion(struct htu21d *self, enum htu21d_channel channel, struct timespec *ready_at)
+{
     if (!self || !self->i2c_bus)
-        return res;
+        return -1;
+
+    uint8_t command = (channel == HTU21D_TEMPERATURE) ? TRIGGER_TEMP_NO_HOLD : TRIGGER_HUMID_NO_HOLD;
 
     /* trigger measurement */
-    if (i2c_write(self->i2c_bus, HTU21D_I2C_ADDR, &command, 1) < 0)
+    if (i2c_write(self->i2c_bus, self->addr, &command, 1) < 0)
     {
         perror("HTU21D: failed to trigger measurement");
-        return res;
+        return -1;
     }
 
-    /* wait for conversion to finish */
-    usleep(HTU21D_MEAS_DELAY_US);
+    self->converting = true;
+    self->channel = channel;
+
+    clock_gettime(CLOCK_MONOTONIC, &self->ready_at);
+    timespec_add_us(&self->ready_at, (channel == HTU21D_TEMPERATURE) ? self->temp_conv_us : self->humid_conv_us);
+
+    if (ready_at)
+        *ready_at = self->ready_at;
+
+    return 0;
+}
 
-    /* read measurement */
-    if (i2c_read(self->i2c_bus, HTU21D_I2C_ADDR, data, 3) < 0)
+int htu21d_poll_conversion(struct htu21d *self, struct htu21d_measurement *res)
+{
+    uint8_t data[3];
+
+    if (!self || !self->i2c_bus || !res || !self->converting)
+        return -1;
+
+    res->is_valid = false;
+    res->value = 0;
+    res->raw = 0;
+
+    /* read measurement: the sensor NACKs its address until the conversion is done */
+    struct I2cMsg msg = {.addr = self->addr, .flags = I2C_MSG_READ, .len = 3, .buf = data};
+
+    if (i2c_transfer(self->i2c_bus, &msg, 1) < 0)
     {
+        if (errno == EREMOTEIO || errno == ENXIO || errno == EIO)
+            return 1;
+
         perror("HTU21D: failed to read data");
-        return res;
+        self->converting = false;
+        return -1;
     }
 
-    /* verify CRC */
-    uint8_t computed_crc = compute_crc8(data, 2);
-    if (computed_crc != data[2])
+    self->converting = false;
+
+    /* verify CRC, convert raw value */
+    if (htu21d_decode(data, self->channel, res) < 0)
     {
-        fprintf(stderr, "HTU21D: CRC mismatch (calc=%d, got=%d)\n", computed_crc, data[2]);
-        return res;
+        fprintf(stderr, "HTU21D: CRC mismatch (calc=%d, got=%d)\n", compute_crc8(data, 2), data[2]);
+        return -1;
     }
 
-    /* convert raw value */
-    uint16_t raw = (data[0] << 8) | (data[1] & MEASUREMENT_MASK);
+    return 0;
+}
 
-    if (meas_type == TEMPERATURE_MEASUREMENT)
-        res.value = -46.85 + (175.72 * raw) / 65536.0;
-    else
-        res.value = -6.0 + (125.0 * raw) / 65536.0;
+struct htu21d_measurement htu21d_finish_conversion(struct htu21d *self)
+{
+    struct htu21d_measurement res = {.is_valid = false, .value = 0};
+
+    if (!self || !self->converting)
+        return res;
+
+    /* wait for conversion to finish */
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &self->ready_at, NULL) == EINTR)
+        ;
+
+    /* then poll, in case the part is slower than the datasheet max */
+    for (int retry = 0; retry < HTU21D_POLL_RETRIES; retry++)
+    {
+        int ret = htu21d_poll_conversion(self, &res);
 
-    res.is_valid = true;
+        if (ret <= 0)
+            return res;
+
+        usleep(HTU21D_POLL_INTERVAL_US);
+    }
+
+    fprintf(stderr, "HTU21D: conversion timed out\n");
+    self->converting = false;
     return res;
 }
 
+void htu21d_cancel_conversion(struct htu21d *self)
+{
+    if (self)
+        self->converting = false;
+}
+
+static struct htu21d_measurement get_measurement_no_hold(struct htu21d *self, enum htu21d_channel channel)
+{
+    struct htu21d_measurement res = {.is_valid = false, .value = 0};
+
+    if (htu21d_start_conversion(self, channel, NULL) < 0)
+        return res;
+
+    return htu21d_finish_conversion(self);
+}
+
 struct htu21d_measurement htu21d_read_temperature_no_hold(struct htu21d *self)
 {
-    return get_measurement_no_hold(self, TRIGGER_TEMP_NO_HOLD, TEMPERATURE_MEASUREMENT);
+    return get_measurement_no_hold(self, HTU21D_TEMPERATURE);
 }
 
 struct htu21d_measurement htu21d_read_humidity_no_hold(struct htu21d *self)
 {
-    return get_measurement_no_hold(self, TRIGGER_HUMID_NO_HOLD, HUMIDITY_MEASUREMENT);
+    return get_measurement_no_hold(self, HTU21D_HUMIDITY);
 }
 
 void htu21d_close(struct htu21d *self)
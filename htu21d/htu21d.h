@@ -3,24 +3,89 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
 #include "i2c.h"
 
+#define HTU21D_DEFAULT_ADDR 0x40 // fixed on the HTU21D, some clones can be strapped
+
+#define HTU21D_RESULT_SIZE 3 // MSB, LSB + status bits, CRC-8
+
 struct htu21d_measurement
 {
     bool is_valid;
     float value;
+    uint16_t raw; // word as read, status bits included (for storage/recompensation)
+};
+
+enum htu21d_channel
+{
+    HTU21D_TEMPERATURE,
+    HTU21D_HUMIDITY,
+};
+
+/* Measurement resolution (user register bits 7 and 0) */
+enum htu21d_resolution
+{
+    HTU21D_RES_RH12_T14 = 0x00, // default, 16 ms RH / 50 ms T
+    HTU21D_RES_RH8_T12 = 0x01,  // 3 ms RH / 13 ms T
+    HTU21D_RES_RH10_T13 = 0x80, // 5 ms RH / 25 ms T
+    HTU21D_RES_RH11_T11 = 0x81, // 8 ms RH / 7 ms T
 };
 
 struct htu21d
 {
     struct I2cBus *i2c_bus;
+    uint8_t addr;
+
+    /* Conversion times (datasheet max) for the selected resolution */
+    enum htu21d_resolution resolution;
+    uint32_t temp_conv_us;
+    uint32_t humid_conv_us;
+
+    /* Asynchronous (no-hold) conversion in progress */
+    bool converting;
+    enum htu21d_channel channel;
+    struct timespec ready_at; /* CLOCK_MONOTONIC */
 };
 
-struct htu21d *htu21d_init(struct I2cBus *i2c_bus);
+/* Sensor at `addr` on `i2c_bus`, soft-reset: starts at HTU21D_RES_RH12_T14 with the heater off */
+struct htu21d *htu21d_init(struct I2cBus *i2c_bus, uint8_t addr);
+
+int htu21d_set_resolution(struct htu21d *self, enum htu21d_resolution resolution);
+int htu21d_set_heater(struct htu21d *self, bool enable);
+
+/* 1 if VDD dropped below 2.25 V, 0 if not, -1 on error */
+int htu21d_end_of_battery(struct htu21d *self);
+
 struct htu21d_measurement htu21d_read_temperature_hold(struct htu21d *self);
 struct htu21d_measurement htu21d_read_humidity_hold(struct htu21d *self);
 struct htu21d_measurement htu21d_read_temperature_no_hold(struct htu21d *self);
 struct htu21d_measurement htu21d_read_humidity_no_hold(struct htu21d *self);
+/*
+    Asynchronous acquisition (no-hold master):
+    - htu21d_start_conversion() triggers a conversion and returns at once,
+      `ready_at` (CLOCK_MONOTONIC) is when it is expected to be done
+    - htu21d_poll_conversion() returns 0 with the result, 1 while the sensor
+      still NACKs its address (conversion not done), -1 on error
+    - htu21d_finish_conversion() sleeps until `ready_at` then polls
+    - htu21d_cancel_conversion() gives up on a conversion that never
+      completed (for callers polling on their own timers)
+    Only one conversion can run at a time on a given sensor.
+*/
+int htu21d_start_conversion(struct htu21d *self, enum htu21d_channel channel, struct timespec *ready_at);
+int htu21d_poll_conversion(struct htu21d *self, struct htu21d_measurement *res);
+struct htu21d_measurement htu21d_finish_conversion(struct htu21d *self);
+void htu21d_cancel_conversion(struct htu21d *self);
+
+/*
+    Decode a result as read from the bus (pure, for captured transactions
+    too): 0 with `res` filled, -1 on a CRC mismatch (`res` invalid).
+*/
+int htu21d_decode(const uint8_t data[HTU21D_RESULT_SIZE], enum htu21d_channel channel, struct htu21d_measurement *res);
+
+// Channel of a trigger command byte (hold or no-hold), -1 for any other command
+int htu21d_command_channel(uint8_t command, enum htu21d_channel *channel);
+
 void htu21d_close(struct htu21d *self);
 
 #endif /* HTU21_D_H */
@@ -1,127 +1,367 @@
 #include "i2c.h"
-#include <unistd.h>
-#include <fcntl.h>
-#include <sys/ioctl.h>
+#include "i2c_linux.h"
+#include "i2c_sim.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
 #include <linux/i2c-dev.h>
-#include <malloc.h>
+
+static _Thread_local enum i2c_priority thread_priority = I2C_PRIO_HIGH;
+
+/****************** Lock-free MPSC queue (Vyukov, intrusive) ******************/
+static void i2c_queue_init(struct i2c_queue *q)
+{
+    atomic_store(&q->stub.next, NULL);
+    atomic_store(&q->head, &q->stub);
+    q->tail = &q->stub;
+}
+
+// Any thread
+static void i2c_queue_push(struct i2c_queue *q, struct i2c_qnode *node)
+{
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    struct i2c_qnode *prev = atomic_exchange_explicit(&q->head, node, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+/*
+    Bus-owner thread only. Returns NULL when the queue is empty, or when a
+    producer is between its exchange and its link (the caller retries).
+*/
+static struct i2c_qnode *i2c_queue_pop(struct i2c_queue *q)
+{
+    struct i2c_qnode *tail = q->tail;
+    struct i2c_qnode *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &q->stub)
+    {
+        if (!next)
+            return NULL;
+
+        q->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+
+    if (next)
+    {
+        q->tail = next;
+        return tail;
+    }
+
+    if (tail != atomic_load_explicit(&q->head, memory_order_acquire))
+        return NULL;
+
+    // Last element: put the stub back behind it so it can be detached
+    i2c_queue_push(q, &q->stub);
+
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next)
+    {
+        q->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+/****************** Bus-owner thread ******************/
+
+static struct I2cRequest *i2c_next_request(struct I2cBus *self)
+{
+    for (;;)
+    {
+        for (int prio = 0; prio < I2C_PRIO_COUNT; prio++)
+        {
+            struct i2c_qnode *node = i2c_queue_pop(&self->queues[prio]);
+            if (node)
+            {
+                // Served at its own priority: a backend forwarding to another bus (mux) keeps it
+                thread_priority = (enum i2c_priority)prio;
+                return (struct I2cRequest *)node;
+            }
+        }
+
+        // `pending` was posted, so a producer is mid-push: let it finish
+        sched_yield();
+    }
+}
+
+static void i2c_complete(struct I2cRequest *req)
+{
+    if (req->on_complete)
+        req->on_complete(req, req->arg);
+
+    sem_post(&req->done);
+}
+
+// After the stop marker: fail whatever is still queued, so that no caller waits forever
+static void i2c_drain(struct I2cBus *self)
+{
+    while (sem_trywait(&self->pending) == 0)
+    {
+        struct I2cRequest *req = i2c_next_request(self);
+
+        req->status = -ESHUTDOWN;
+        atomic_fetch_add_explicit(&self->errors, 1, memory_order_relaxed);
+        i2c_complete(req);
+    }
+}
+
+static void *i2c_bus_thread(void *arg)
+{
+    struct I2cBus *self = (struct I2cBus *)arg;
+
+    for (;;)
+    {
+        if (sem_wait(&self->pending) < 0)
+            continue; // EINTR
+
+        struct I2cRequest *req = i2c_next_request(self);
+
+        // A request without messages is the stop marker queued by i2c_close()
+        if (req->count == 0)
+        {
+            i2c_drain(self);
+            sem_post(&req->done);
+            break;
+        }
+
+        req->status = self->ops->transfer(self->backend, req->msgs, req->count, req->combined);
+
+        atomic_fetch_add_explicit(&self->transactions, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&self->messages, req->count, memory_order_relaxed);
+        for (size_t i = 0; i < req->count; i++)
+            atomic_fetch_add_explicit(&self->bytes, req->msgs[i].len, memory_order_relaxed);
+        if (req->status < 0)
+            atomic_fetch_add_explicit(&self->errors, 1, memory_order_relaxed);
+
+        i2c_complete(req);
+    }
+
+    return NULL;
+}
+
+/****************** Public API ******************/
 
 // Function to initialize I2C
 struct I2cBus *i2c_init(char *i2c_path)
 {
-    int i2c_fd = open(i2c_path, O_RDWR);
-    if (i2c_fd < 0)
+    if (!i2c_path)
+        return NULL;
+
+    if (strcmp(i2c_path, I2C_SIM_PATH) == 0)
+        return i2c_init_backend(&i2c_sim_ops, i2c_sim_open());
+
+    return i2c_init_backend(&i2c_linux_ops, i2c_linux_open(i2c_path));
+}
+
+struct I2cBus *i2c_init_backend(const struct i2c_backend_ops *ops, void *backend)
+{
+    if (!ops || !backend)
     {
-        perror("Failed to open I2C bus");
         return NULL;
     }
 
-    struct I2cBus *ret = (struct I2cBus *)malloc(sizeof(struct I2cBus));
+    struct I2cBus *ret = (struct I2cBus *)calloc(1, sizeof(struct I2cBus));
 
     if (!ret)
     {
+        ops->close(backend);
         return ret;
     }
 
-    ret->i2c_fd = i2c_fd;
+    ret->ops = ops;
+    ret->backend = backend;
+
+    for (int prio = 0; prio < I2C_PRIO_COUNT; prio++)
+        i2c_queue_init(&ret->queues[prio]);
+
+    sem_init(&ret->pending, 0, 0);
+    atomic_store(&ret->running, true);
+
+    if (pthread_create(&ret->thread, NULL, i2c_bus_thread, ret) != 0)
+    {
+        perror("Failed to start I2C bus thread");
+        sem_destroy(&ret->pending);
+        ops->close(backend);
+        free(ret);
+        return NULL;
+    }
 
     return ret;
 }
 
-// Generic I2C write (send raw bytes to device)
-int i2c_write(struct I2cBus *self, uint8_t device_addr, const uint8_t *data, size_t len)
+void i2c_get_stats(struct I2cBus *self, struct i2c_stats *stats)
 {
-    if (!self || !data || len == 0)
-        return -1;
+    if (!self || !stats)
+        return;
 
-    if (ioctl(self->i2c_fd, I2C_SLAVE, device_addr) < 0)
-    {
-        perror("Failed to select I2C device");
+    stats->transactions = atomic_load_explicit(&self->transactions, memory_order_relaxed);
+    stats->messages = atomic_load_explicit(&self->messages, memory_order_relaxed);
+    stats->bytes = atomic_load_explicit(&self->bytes, memory_order_relaxed);
+    stats->errors = atomic_load_explicit(&self->errors, memory_order_relaxed);
+}
+
+void i2c_set_thread_priority(enum i2c_priority prio)
+{
+    if (prio < I2C_PRIO_COUNT)
+        thread_priority = prio;
+}
+
+enum i2c_priority i2c_get_thread_priority(void)
+{
+    return thread_priority;
+}
+
+int i2c_submit(struct I2cBus *self, struct I2cRequest *req, enum i2c_priority prio)
+{
+    if (!self || !req || !req->msgs || req->count == 0 || req->count > I2C_RDWR_IOCTL_MAX_MSGS || prio >= I2C_PRIO_COUNT)
         return -1;
-    }
 
-    if (write(self->i2c_fd, data, len) != (ssize_t)len)
+    // Announce the push before checking `running`: i2c_close() clears it, then waits for this count
+    atomic_fetch_add(&self->submitting, 1);
+
+    if (!atomic_load(&self->running))
     {
-        perror("Failed to write I2C data");
+        atomic_fetch_sub(&self->submitting, 1);
         return -1;
     }
 
+    req->status = 0;
+    sem_init(&req->done, 0, 0);
+
+    i2c_queue_push(&self->queues[prio], &req->node);
+    sem_post(&self->pending);
+
+    atomic_fetch_sub(&self->submitting, 1);
+
     return 0;
 }
 
-// Generic I2C read (read raw bytes from device)
-int i2c_read(struct I2cBus *self, uint8_t device_addr, uint8_t *buffer, size_t len)
+int i2c_request_wait(struct I2cRequest *req)
 {
-    if (!self || !buffer || len == 0)
-        return -1;
+    while (sem_wait(&req->done) < 0)
+        ; // EINTR
+
+    sem_destroy(&req->done);
 
-    if (ioctl(self->i2c_fd, I2C_SLAVE, device_addr) < 0)
+    return req->status;
+}
+
+// Submit at the calling thread's priority and wait; returns 0 or -1 with errno set
+static int i2c_run(struct I2cBus *self, struct I2cMsg *msgs, size_t count, bool combined)
+{
+    struct I2cRequest req = {
+        .msgs = msgs,
+        .count = count,
+        .combined = combined,
+    };
+
+    if (i2c_submit(self, &req, thread_priority) < 0)
     {
-        perror("Failed to select I2C device");
+        errno = EINVAL;
         return -1;
     }
 
-    if (read(self->i2c_fd, buffer, len) != (ssize_t)len)
+    int status = i2c_request_wait(&req);
+    if (status < 0)
     {
-        perror("Failed to read I2C data");
+        errno = -status;
         return -1;
     }
 
     return 0;
 }
 
-// Function to read a register from a given device
-int i2c_read_register(struct I2cBus *self, uint8_t device_addr, uint8_t reg, uint8_t *buffer, size_t len)
+// Generic I2C write (send raw bytes to device)
+int i2c_write(struct I2cBus *self, uint8_t device_addr, const uint8_t *data, size_t len)
 {
-    if (!self)
+    if (!self || !data || len == 0 || len > UINT16_MAX)
+        return -1;
+
+    struct I2cMsg msg = {.addr = device_addr, .flags = I2C_MSG_WRITE, .len = (uint16_t)len, .buf = (uint8_t *)data};
+
+    if (i2c_run(self, &msg, 1, false) < 0)
     {
+        perror("Failed to write I2C data");
         return -1;
     }
 
-    if (ioctl(self->i2c_fd, I2C_SLAVE, device_addr) < 0)
+    return 0;
+}
+
+// Generic I2C read (read raw bytes from device)
+int i2c_read(struct I2cBus *self, uint8_t device_addr, uint8_t *buffer, size_t len)
+{
+    if (!self || !buffer || len == 0 || len > UINT16_MAX)
+        return -1;
+
+    struct I2cMsg msg = {.addr = device_addr, .flags = I2C_MSG_READ, .len = (uint16_t)len, .buf = buffer};
+
+    if (i2c_run(self, &msg, 1, false) < 0)
     {
-        perror("Failed to select I2C device");
+        perror("Failed to read I2C data");
         return -1;
     }
 
-    // Write register address
-    if (write(self->i2c_fd, &reg, 1) != 1)
+    return 0;
+}
+
+// Combined write/read sequence with repeated-start (single ioctl)
+int i2c_transfer(struct I2cBus *self, struct I2cMsg *msgs, size_t count)
+{
+    if (!self || !msgs || count == 0 || count > I2C_RDWR_IOCTL_MAX_MSGS)
     {
-        perror("Failed to write register address");
+        errno = EINVAL;
         return -1;
     }
 
-    // Read data from register
-    if (read(self->i2c_fd, buffer, len) != (ssize_t)len)
+    return i2c_run(self, msgs, count, true);
+}
+
+int i2c_write_read(struct I2cBus *self, uint8_t device_addr, const uint8_t *wbuf, size_t wlen, uint8_t *rbuf, size_t rlen)
+{
+    if (!self || !wbuf || !rbuf || wlen == 0 || rlen == 0 || wlen > UINT16_MAX || rlen > UINT16_MAX)
+        return -1;
+
+    struct I2cMsg msgs[2] = {
+        {.addr = device_addr, .flags = I2C_MSG_WRITE, .len = (uint16_t)wlen, .buf = (uint8_t *)wbuf},
+        {.addr = device_addr, .flags = I2C_MSG_READ, .len = (uint16_t)rlen, .buf = rbuf},
+    };
+
+    if (i2c_transfer(self, msgs, 2) < 0)
     {
-        perror("Failed to read data");
+        perror("Failed to run I2C write/read transaction");
         return -1;
     }
 
     return 0;
 }
 
-int i2c_write_register(struct I2cBus *self, uint8_t device_addr, uint8_t reg, uint8_t value)
+// Function to read a register from a given device
+int i2c_read_register(struct I2cBus *self, uint8_t device_addr, uint8_t reg, uint8_t *buffer, size_t len)
 {
     if (!self)
     {
         return -1;
     }
 
-    if (ioctl(self->i2c_fd, I2C_SLAVE, device_addr) < 0)
+    // Register address write + data read, with repeated-start in between
+    return i2c_write_read(self, device_addr, &reg, 1, buffer, len);
+}
+
+int i2c_write_register(struct I2cBus *self, uint8_t device_addr, uint8_t reg, uint8_t value)
+{
+    if (!self)
     {
-        perror("Failed to select I2C device");
         return -1;
     }
 
     uint8_t config[2] = {reg, value};
 
-    if (write(self->i2c_fd, config, 2) != 2)
-    {
-        perror("Failed to write register address");
-        return -1;
-    }
-
-    return 0;
+    return i2c_write(self, device_addr, config, 2);
 }
 
 int i2c_close(struct I2cBus *self)
@@ -131,9 +371,25 @@ int i2c_close(struct I2cBus *self)
         return -1;
     }
 
-    int ret = close(self->i2c_fd);
+    struct I2cRequest stop = {0};
+    sem_init(&stop.done, 0, 0);
+
+    // No new submission past this point; let those already past the check finish their push
+    atomic_store(&self->running, false);
+    while (atomic_load(&self->submitting) > 0)
+        sched_yield();
+
+    // Then queue a stop marker behind everything already submitted (lowest priority)
+    i2c_queue_push(&self->queues[I2C_PRIO_COUNT - 1], &stop.node);
+    sem_post(&self->pending);
+
+    pthread_join(self->thread, NULL);
+    sem_destroy(&stop.done);
+    sem_destroy(&self->pending);
+
+    self->ops->close(self->backend);
 
     free(self);
 
-    return ret;
+    return 0;
 }
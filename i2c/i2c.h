@@ -3,21 +3,167 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#define I2C_MSG_WRITE 0x0000
+#define I2C_MSG_READ 0x0001
+
+/* One segment of a combined transaction (see i2c_transfer) */
+struct I2cMsg
+{
+    uint8_t addr;
+    uint16_t flags; // I2C_MSG_WRITE or I2C_MSG_READ
+    uint16_t len; // the helpers below reject longer buffers (-1)
+    uint8_t *buf;
+};
+
+/*
+    Request priority: the bus-owner thread always drains the HIGH queue
+    before looking at the LOW one, so sensor reads never wait behind a
+    stream of LCD refresh writes.
+*/
+enum i2c_priority
+{
+    I2C_PRIO_HIGH = 0, // sensor acquisition
+    I2C_PRIO_LOW,      // display refresh
+    I2C_PRIO_COUNT
+};
+
+/* Intrusive link of the lock-free MPSC request queue */
+struct i2c_qnode
+{
+    struct i2c_qnode *_Atomic next;
+};
+
+struct i2c_queue
+{
+    struct i2c_qnode *_Atomic head; // producers push here
+    struct i2c_qnode *tail;         // only touched by the bus-owner thread
+    struct i2c_qnode stub;
+};
+
+struct I2cRequest;
+
+typedef void (*i2c_completion_cb)(struct I2cRequest *req, void *arg);
+
+/*
+    A transaction handed to the bus-owner thread.
+    The caller owns the memory and must keep it alive until completion.
+*/
+struct I2cRequest
+{
+    struct i2c_qnode node; // must stay first
+
+    struct I2cMsg *msgs;
+    size_t count;
+    bool combined; // true: one I2C_RDWR with repeated-start, false: plain read()/write() per segment
+
+    int status; // 0 on success, -errno on failure
+
+    // Called from the bus-owner thread once the transaction is done (may be NULL)
+    i2c_completion_cb on_complete;
+    void *arg;
+
+    sem_t done; // future: posted after on_complete returned
+};
+
+/*
+    Bus backend: executes one transaction on the underlying bus.
+    Only ever called from the bus-owner thread.
+*/
+struct i2c_backend_ops
+{
+    const char *name;
+    // Returns 0 on success, -errno on failure (-EREMOTEIO/-ENXIO: NACK)
+    int (*transfer)(void *backend, struct I2cMsg *msgs, size_t count, bool combined);
+    void (*close)(void *backend);
+};
+
+/* Bus activity counters, updated by the bus-owner thread */
+struct i2c_stats
+{
+    uint64_t transactions; // requests executed (one per ioctl/read/write sequence)
+    uint64_t messages;     // segments
+    uint64_t bytes;        // payload bytes, both directions
+    uint64_t errors;
+};
 
 struct I2cBus
 {
-    int i2c_fd;
+    const struct i2c_backend_ops *ops;
+    void *backend;
+
+    _Atomic uint64_t transactions;
+    _Atomic uint64_t messages;
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t errors;
+
+    struct i2c_queue queues[I2C_PRIO_COUNT];
+    sem_t pending; // one post per queued request
+
+    _Atomic bool running;
+    _Atomic int submitting; // i2c_submit() calls in flight, waited for by i2c_close()
+    pthread_t thread;
 };
 
-// Function to initialize I2C
+/*
+    Function to initialize I2C (also starts the bus-owner thread).
+    `i2c_path` is an i2c-dev node ("/dev/i2c-1"), or "sim" for the
+    in-memory simulated devices (see i2c_sim.h).
+*/
 struct I2cBus *i2c_init(char *i2c_path);
+
+// Same, on top of an already opened backend (ownership is transferred)
+struct I2cBus *i2c_init_backend(const struct i2c_backend_ops *ops, void *backend);
+
+// Snapshot of the bus activity counters
+void i2c_get_stats(struct I2cBus *self, struct i2c_stats *stats);
+
+/*
+    Priority used by the synchronous helpers below when called from the
+    current thread (I2C_PRIO_HIGH unless changed).
+*/
+void i2c_set_thread_priority(enum i2c_priority prio);
+
+// On a bus-owner thread: priority of the request being served
+enum i2c_priority i2c_get_thread_priority(void);
+
+/*
+    Asynchronous API: queue `req` (msgs/count/combined/on_complete/arg filled
+    by the caller) and return immediately. Completion is signalled through
+    on_complete and/or i2c_request_wait(). Never wait on a request from inside
+    a completion callback: it runs on the bus-owner thread.
+*/
+int i2c_submit(struct I2cBus *self, struct I2cRequest *req, enum i2c_priority prio);
+
+// Block until `req` completed, release it and return its status (0 or -errno)
+int i2c_request_wait(struct I2cRequest *req);
+
 int i2c_write(struct I2cBus *self, uint8_t device_addr, const uint8_t *data, size_t len);
 int i2c_read(struct I2cBus *self, uint8_t device_addr, uint8_t *buffer, size_t len);
 int i2c_read_register(struct I2cBus *self, uint8_t device_addr, uint8_t reg, uint8_t *buffer, size_t len);
 
+/*
+    Run a whole write/read sequence in a single I2C_RDWR ioctl: segments are
+    chained with repeated-start and only one STOP is sent at the end, so no
+    other master can take the bus in between.
+    Returns 0 on success, -1 on failure (errno set, nothing printed).
+*/
+int i2c_transfer(struct I2cBus *self, struct I2cMsg *msgs, size_t count);
+
+// Write `wlen` bytes then read `rlen` bytes back in one combined transaction
+int i2c_write_read(struct I2cBus *self, uint8_t device_addr, const uint8_t *wbuf, size_t wlen, uint8_t *rbuf, size_t rlen);
+
 // Function to write a register from a given device
 int i2c_write_register(struct I2cBus *self, uint8_t device_addr, uint8_t reg, uint8_t val);
 
+/*
+    Stop the bus-owner thread and close the bus. Requests submitted before
+    the call are still served; i2c_submit() fails once it has started.
+*/
 int i2c_close(struct I2cBus *self);
 
 #endif /* I2C_BUS_H */
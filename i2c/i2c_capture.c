@@ -0,0 +1,287 @@
+#include "i2c_capture.h"
+#include <stdlib.h>
+#include <string.h>
+#include "i2c_linux.h"
+#include "i2c_sim.h"
+
+struct i2c_capture
+{
+    const struct i2c_backend_ops *ops; // decorated backend
+    void *backend;
+    struct i2c_capture_log *log;
+    uint8_t bus;
+};
+
+struct i2c_capture_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+static bool log_write(struct i2c_capture_log *log, const void *data, size_t len)
+{
+    return len == 0 || fwrite(data, len, 1, log->file) == 1;
+}
+
+// Called with the log lock held
+static void log_failed(struct i2c_capture_log *log)
+{
+    if (!log->failed)
+        perror("I2C capture: write failed, capture stopped");
+    log->failed = true;
+}
+
+// Runs on the bus-owner thread
+static int i2c_capture_transfer(void *backend, struct I2cMsg *msgs, size_t count, bool combined)
+{
+    struct i2c_capture *self = (struct i2c_capture *)backend;
+    struct i2c_capture_log *log = self->log;
+    struct timespec now;
+
+    int ret = self->ops->transfer(self->backend, msgs, count, combined);
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    uint64_t t_ns = (uint64_t)((now.tv_sec - log->start.tv_sec) * 1000000000LL + (now.tv_nsec - log->start.tv_nsec));
+    uint8_t head[3] = {I2C_CAPTURE_XFER, self->bus, (uint8_t)(count > I2C_CAPTURE_MAX_MSGS ? I2C_CAPTURE_MAX_MSGS : count)};
+    uint8_t flag = combined;
+    int16_t status = (int16_t)ret;
+    bool ok = true;
+
+    pthread_mutex_lock(&log->lock);
+
+    if (!log->failed)
+    {
+        ok = log_write(log, head, sizeof(head)) && log_write(log, &flag, 1) && log_write(log, &status, sizeof(status)) &&
+             log_write(log, &t_ns, sizeof(t_ns));
+
+        for (size_t i = 0; ok && i < head[2]; i++)
+        {
+            uint8_t msg_head[2] = {msgs[i].addr, (uint8_t)((msgs[i].flags & I2C_MSG_READ) != 0)};
+            bool payload = !msg_head[1] || ret == 0;
+
+            ok = log_write(log, msg_head, sizeof(msg_head)) && log_write(log, &msgs[i].len, sizeof(msgs[i].len)) &&
+                 (!payload || log_write(log, msgs[i].buf, msgs[i].len));
+        }
+
+        if (ok)
+            log->transfers++;
+        else
+            log_failed(log);
+    }
+
+    pthread_mutex_unlock(&log->lock);
+
+    return ret;
+}
+
+static void i2c_capture_close(void *backend)
+{
+    struct i2c_capture *self = (struct i2c_capture *)backend;
+
+    self->ops->close(self->backend);
+    free(self);
+}
+
+const struct i2c_backend_ops i2c_capture_ops = {
+    .name = "capture",
+    .transfer = i2c_capture_transfer,
+    .close = i2c_capture_close,
+};
+
+struct i2c_capture_log *i2c_capture_log_open(const char *path)
+{
+    struct i2c_capture_header header = {.magic = I2C_CAPTURE_MAGIC, .version = I2C_CAPTURE_VERSION};
+
+    if (!path)
+        return NULL;
+
+    struct i2c_capture_log *log = (struct i2c_capture_log *)calloc(1, sizeof(struct i2c_capture_log));
+    if (!log)
+        return NULL;
+
+    log->file = fopen(path, "wb");
+    if (!log->file)
+    {
+        perror("Failed to create the I2C capture");
+        free(log);
+        return NULL;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, log->file) != 1)
+    {
+        perror("Failed to write the I2C capture");
+        fclose(log->file);
+        free(log);
+        return NULL;
+    }
+
+    pthread_mutex_init(&log->lock, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &log->start);
+
+    return log;
+}
+
+void i2c_capture_log_close(struct i2c_capture_log *log)
+{
+    if (!log)
+        return;
+
+    if (fclose(log->file) != 0 && !log->failed)
+        perror("Failed to write the I2C capture");
+
+    pthread_mutex_destroy(&log->lock);
+    free(log);
+}
+
+struct I2cBus *i2c_capture_init(struct i2c_capture_log *log, const char *name, char *i2c_path)
+{
+    if (!log || !name || !i2c_path)
+        return NULL;
+
+    size_t name_len = strlen(name);
+    if (name_len >= I2C_CAPTURE_NAME_SIZE || log->bus_count == I2C_CAPTURE_MAX_BUSES)
+        return NULL;
+
+    struct i2c_capture *self = (struct i2c_capture *)malloc(sizeof(struct i2c_capture));
+    if (!self)
+        return NULL;
+
+    if (strcmp(i2c_path, I2C_SIM_PATH) == 0)
+    {
+        self->ops = &i2c_sim_ops;
+        self->backend = i2c_sim_open();
+    }
+    else
+    {
+        self->ops = &i2c_linux_ops;
+        self->backend = i2c_linux_open(i2c_path);
+    }
+
+    if (!self->backend)
+    {
+        free(self);
+        return NULL;
+    }
+
+    self->log = log;
+
+    // Before the bus thread starts: no transfer can be logged ahead of its bus record
+    pthread_mutex_lock(&log->lock);
+    self->bus = log->bus_count++;
+    uint8_t record[3] = {I2C_CAPTURE_BUS, self->bus, (uint8_t)name_len};
+    if (!log_write(log, record, sizeof(record)) || !log_write(log, name, name_len))
+        log_failed(log);
+    pthread_mutex_unlock(&log->lock);
+
+    return i2c_init_backend(&i2c_capture_ops, self);
+}
+
+/****************** Reader ******************/
+
+struct i2c_capture_reader *i2c_capture_reader_open(const char *path)
+{
+    struct i2c_capture_header header;
+
+    if (!path)
+        return NULL;
+
+    struct i2c_capture_reader *self = (struct i2c_capture_reader *)calloc(1, sizeof(struct i2c_capture_reader));
+    if (!self)
+        return NULL;
+
+    self->file = fopen(path, "rb");
+    if (!self->file)
+    {
+        perror("Failed to open the I2C capture");
+        free(self);
+        return NULL;
+    }
+
+    if (fread(&header, sizeof(header), 1, self->file) != 1 ||
+        memcmp(header.magic, I2C_CAPTURE_MAGIC, sizeof(header.magic)) != 0 || header.version != I2C_CAPTURE_VERSION)
+    {
+        fprintf(stderr, "%s: not an I2C capture (version %d)\n", path, I2C_CAPTURE_VERSION);
+        i2c_capture_reader_close(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+static bool reader_get(struct i2c_capture_reader *self, void *data, size_t len)
+{
+    return len == 0 || fread(data, len, 1, self->file) == 1;
+}
+
+int i2c_capture_read(struct i2c_capture_reader *self, struct i2c_capture_xfer *xfer)
+{
+    uint8_t type;
+
+    if (!self || !xfer)
+        return -1;
+
+    while (reader_get(self, &type, 1))
+    {
+        uint8_t head[2];
+        if (!reader_get(self, head, sizeof(head)) || head[0] >= I2C_CAPTURE_MAX_BUSES)
+            return -1;
+
+        if (type == I2C_CAPTURE_BUS)
+        {
+            if (head[1] >= I2C_CAPTURE_NAME_SIZE || !reader_get(self, self->bus_names[head[0]], head[1]))
+                return -1;
+            self->bus_names[head[0]][head[1]] = '\0';
+            continue;
+        }
+
+        if (type != I2C_CAPTURE_XFER || head[1] > I2C_CAPTURE_MAX_MSGS)
+            return -1;
+
+        uint8_t flag;
+        int16_t status;
+        if (!reader_get(self, &flag, 1) || !reader_get(self, &status, sizeof(status)) ||
+            !reader_get(self, &xfer->t_ns, sizeof(xfer->t_ns)))
+            return -1;
+
+        xfer->bus = head[0];
+        xfer->bus_name = self->bus_names[head[0]];
+        xfer->combined = flag != 0;
+        xfer->status = status;
+        xfer->count = head[1];
+
+        for (size_t i = 0; i < xfer->count; i++)
+        {
+            struct i2c_capture_msg *msg = &xfer->msgs[i];
+            uint8_t msg_head[2];
+
+            if (!reader_get(self, msg_head, sizeof(msg_head)) || !reader_get(self, &msg->len, sizeof(msg->len)))
+                return -1;
+
+            msg->addr = msg_head[0];
+            msg->read = msg_head[1] != 0;
+            msg->data = NULL;
+
+            if (!msg->read || status == 0)
+            {
+                if (!reader_get(self, self->payload[i], msg->len))
+                    return -1;
+                msg->data = self->payload[i];
+            }
+        }
+
+        return 1;
+    }
+
+    return feof(self->file) ? 0 : -1;
+}
+
+void i2c_capture_reader_close(struct i2c_capture_reader *self)
+{
+    if (!self)
+        return;
+
+    fclose(self->file);
+    free(self);
+}
@@ -0,0 +1,100 @@
+#ifndef I2C_CAPTURE_H
+#define I2C_CAPTURE_H
+
+/*
+    Raw transaction capture: a backend decorator that runs each transaction
+    on the real backend, then appends it to a binary log with its
+    CLOCK_MONOTONIC time, so field issues can be replayed and the decode
+    and storage paths benchmarked on real bytes (see replay.h).
+
+    Log layout (native endianness, like the segment store):
+    - header: "PHSI2CAP", uint32 version, uint32 0
+    - records, each starting with a uint8 type:
+      BUS:  uint8 bus id, uint8 name length, name (the configured bus path)
+      XFER: uint8 bus id, uint8 message count, uint8 combined,
+            int16 status (0 or -errno), uint64 ns since the capture started,
+            then per message: uint8 addr, uint8 read, uint16 len, and the
+            payload (written bytes; read bytes only if the transfer succeeded)
+    Every bus of the process can share one log.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include "i2c.h"
+
+#define I2C_CAPTURE_MAGIC "PHSI2CAP"
+#define I2C_CAPTURE_VERSION 1
+#define I2C_CAPTURE_MAX_BUSES 16
+#define I2C_CAPTURE_MAX_MSGS 8
+#define I2C_CAPTURE_NAME_SIZE 64
+
+enum i2c_capture_record_type
+{
+    I2C_CAPTURE_BUS = 1,
+    I2C_CAPTURE_XFER = 2,
+};
+
+struct i2c_capture_log
+{
+    FILE *file;
+    pthread_mutex_t lock; // bus-owner threads append concurrently
+    struct timespec start;
+    uint8_t bus_count;
+    uint64_t transfers;
+    bool failed; // a write failed: capture stopped, reported at close
+};
+
+extern const struct i2c_backend_ops i2c_capture_ops;
+
+// Create (truncate) the log at `path`, returns NULL on failure
+struct i2c_capture_log *i2c_capture_log_open(const char *path);
+
+// Flush and close; the buses capturing into it must be closed first
+void i2c_capture_log_close(struct i2c_capture_log *log);
+
+/*
+    Same as i2c_init(), every transaction also captured into `log` under
+    `name` (the configured bus path, also when `i2c_path` is the simulator).
+*/
+struct I2cBus *i2c_capture_init(struct i2c_capture_log *log, const char *name, char *i2c_path);
+
+/****************** Reading a log back ******************/
+
+struct i2c_capture_msg
+{
+    uint8_t addr;
+    bool read;
+    uint16_t len;
+    const uint8_t *data; // NULL for a read that failed
+};
+
+struct i2c_capture_xfer
+{
+    uint8_t bus;
+    const char *bus_name;
+    bool combined;
+    int status;
+    uint64_t t_ns; // since the capture started
+    size_t count;
+    struct i2c_capture_msg msgs[I2C_CAPTURE_MAX_MSGS];
+};
+
+struct i2c_capture_reader
+{
+    FILE *file;
+    char bus_names[I2C_CAPTURE_MAX_BUSES][I2C_CAPTURE_NAME_SIZE];
+    uint8_t payload[I2C_CAPTURE_MAX_MSGS][UINT16_MAX]; // backing store of the last transfer
+};
+
+// Returns NULL (reported) if `path` is not a capture log
+struct i2c_capture_reader *i2c_capture_reader_open(const char *path);
+
+// Next transfer, bus records handled on the way: 1, 0 at the end, -1 if the log is corrupt
+int i2c_capture_read(struct i2c_capture_reader *self, struct i2c_capture_xfer *xfer);
+
+void i2c_capture_reader_close(struct i2c_capture_reader *self);
+
+#endif /* I2C_CAPTURE_H */
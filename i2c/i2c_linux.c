@@ -0,0 +1,118 @@
+#include "i2c_linux.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+
+struct i2c_linux
+{
+    int i2c_fd;
+    int current_addr; // last address selected with I2C_SLAVE (-1: none)
+};
+
+void *i2c_linux_open(const char *i2c_path)
+{
+    int i2c_fd = open(i2c_path, O_RDWR);
+    if (i2c_fd < 0)
+    {
+        perror("Failed to open I2C bus");
+        return NULL;
+    }
+
+    struct i2c_linux *ret = (struct i2c_linux *)malloc(sizeof(struct i2c_linux));
+
+    if (!ret)
+    {
+        close(i2c_fd);
+        return NULL;
+    }
+
+    ret->i2c_fd = i2c_fd;
+    ret->current_addr = -1;
+
+    return ret;
+}
+
+// Select the target device, skipping the ioctl when it is already selected
+static int i2c_linux_select(struct i2c_linux *self, uint8_t device_addr)
+{
+    if (self->current_addr == device_addr)
+        return 0;
+
+    if (ioctl(self->i2c_fd, I2C_SLAVE, device_addr) < 0)
+    {
+        self->current_addr = -1;
+        return -1;
+    }
+
+    self->current_addr = device_addr;
+    return 0;
+}
+
+static int i2c_linux_transfer(void *backend, struct I2cMsg *msgs, size_t count, bool combined)
+{
+    struct i2c_linux *self = (struct i2c_linux *)backend;
+
+    if (combined)
+    {
+        struct i2c_msg kmsgs[I2C_RDWR_IOCTL_MAX_MSGS];
+
+        for (size_t i = 0; i < count; i++)
+        {
+            kmsgs[i].addr = msgs[i].addr;
+            kmsgs[i].flags = (msgs[i].flags & I2C_MSG_READ) ? I2C_M_RD : 0;
+            kmsgs[i].len = msgs[i].len;
+            kmsgs[i].buf = msgs[i].buf;
+        }
+
+        struct i2c_rdwr_ioctl_data rdwr = {
+            .msgs = kmsgs,
+            .nmsgs = count,
+        };
+
+        // The ioctl returns the number of messages transferred
+        errno = 0;
+        if (ioctl(self->i2c_fd, I2C_RDWR, &rdwr) != (int)count)
+            return errno ? -errno : -EIO;
+
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        struct I2cMsg *msg = &msgs[i];
+        ssize_t n;
+
+        if (i2c_linux_select(self, msg->addr) < 0)
+            return -errno;
+
+        if (msg->flags & I2C_MSG_READ)
+            n = read(self->i2c_fd, msg->buf, msg->len);
+        else
+            n = write(self->i2c_fd, msg->buf, msg->len);
+
+        if (n < 0)
+            return -errno;
+        if (n != msg->len)
+            return -EIO;
+    }
+
+    return 0;
+}
+
+static void i2c_linux_close(void *backend)
+{
+    struct i2c_linux *self = (struct i2c_linux *)backend;
+
+    close(self->i2c_fd);
+    free(self);
+}
+
+const struct i2c_backend_ops i2c_linux_ops = {
+    .name = "i2c-dev",
+    .transfer = i2c_linux_transfer,
+    .close = i2c_linux_close,
+};
@@ -0,0 +1,13 @@
+#ifndef I2C_LINUX_H
+#define I2C_LINUX_H
+
+/* Linux i2c-dev backend (/dev/i2c-N) */
+
+#include "i2c.h"
+
+extern const struct i2c_backend_ops i2c_linux_ops;
+
+// Open an i2c-dev node, returns the backend handle or NULL
+void *i2c_linux_open(const char *i2c_path);
+
+#endif /* I2C_LINUX_H */
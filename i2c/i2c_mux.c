@@ -0,0 +1,113 @@
+#include "i2c_mux.h"
+#include <stdlib.h>
+#include <errno.h>
+
+struct i2c_mux_channel
+{
+    struct i2c_mux *mux;
+    uint8_t channel;
+};
+
+/*
+    Run one request on the parent bus and wait for it (called with the mux
+    lock held), at the priority the channel's request was submitted with.
+*/
+static int i2c_mux_forward(struct i2c_mux *mux, struct I2cMsg *msgs, size_t count, bool combined)
+{
+    struct I2cRequest req = {
+        .msgs = msgs,
+        .count = count,
+        .combined = combined,
+    };
+
+    if (i2c_submit(mux->parent, &req, i2c_get_thread_priority()) < 0)
+        return -EINVAL;
+
+    return i2c_request_wait(&req);
+}
+
+static int i2c_mux_select(struct i2c_mux *mux, uint8_t control)
+{
+    if (mux->selected == control)
+        return 0;
+
+    struct I2cMsg msg = {.addr = mux->addr, .flags = I2C_MSG_WRITE, .len = 1, .buf = &control};
+
+    int ret = i2c_mux_forward(mux, &msg, 1, false);
+    mux->selected = (ret == 0) ? control : -1;
+
+    return ret;
+}
+
+// Runs on the channel's bus-owner thread
+static int i2c_mux_transfer(void *backend, struct I2cMsg *msgs, size_t count, bool combined)
+{
+    struct i2c_mux_channel *self = (struct i2c_mux_channel *)backend;
+    struct i2c_mux *mux = self->mux;
+
+    pthread_mutex_lock(&mux->lock);
+
+    int ret = i2c_mux_select(mux, 1u << self->channel);
+    if (ret == 0)
+        ret = i2c_mux_forward(mux, msgs, count, combined);
+
+    pthread_mutex_unlock(&mux->lock);
+
+    return ret;
+}
+
+static void i2c_mux_close(void *backend)
+{
+    free(backend);
+}
+
+const struct i2c_backend_ops i2c_mux_ops = {
+    .name = "tca9548a",
+    .transfer = i2c_mux_transfer,
+    .close = i2c_mux_close,
+};
+
+struct i2c_mux *i2c_mux_create(struct I2cBus *parent, uint8_t addr)
+{
+    if (!parent)
+        return NULL;
+
+    struct i2c_mux *ret = (struct i2c_mux *)malloc(sizeof(struct i2c_mux));
+    if (!ret)
+        return NULL;
+
+    ret->parent = parent;
+    ret->addr = addr;
+    ret->selected = -1;
+    pthread_mutex_init(&ret->lock, NULL);
+
+    return ret;
+}
+
+struct I2cBus *i2c_mux_channel(struct i2c_mux *mux, uint8_t channel)
+{
+    if (!mux || channel >= TCA9548A_CHANNELS)
+        return NULL;
+
+    struct i2c_mux_channel *backend = (struct i2c_mux_channel *)malloc(sizeof(struct i2c_mux_channel));
+    if (!backend)
+        return NULL;
+
+    backend->mux = mux;
+    backend->channel = channel;
+
+    return i2c_init_backend(&i2c_mux_ops, backend);
+}
+
+void i2c_mux_destroy(struct i2c_mux *mux)
+{
+    if (!mux)
+        return;
+
+    pthread_mutex_lock(&mux->lock);
+    i2c_mux_select(mux, 0);
+    pthread_mutex_unlock(&mux->lock);
+
+    pthread_mutex_destroy(&mux->lock);
+    free(mux);
+}
@@ -0,0 +1,43 @@
+#ifndef I2C_MUX_H
+#define I2C_MUX_H
+
+/*
+    TCA9548A 8-channel I2C multiplexer. Each downstream channel is exposed
+    as its own I2cBus (a backend forwarding to the parent bus), so drivers
+    use it like any other bus. A transaction on a channel first writes the
+    channel to the control register if another one is selected (it only
+    takes effect at the STOP, hence a separate transaction), then runs on
+    the parent; the mux lock keeps both together.
+    Channels of different muxes on the same parent are not deselected:
+    give their devices distinct addresses.
+*/
+
+#include <pthread.h>
+#include "i2c.h"
+
+#define TCA9548A_DEFAULT_ADDR 0x70 // A0-A2 to GND, up to 0x77
+#define TCA9548A_CHANNELS 8
+
+struct i2c_mux
+{
+    struct I2cBus *parent;
+    uint8_t addr;
+    int selected; // control register value last written (-1: unknown)
+    pthread_mutex_t lock;
+};
+
+extern const struct i2c_backend_ops i2c_mux_ops;
+
+// Mux at `addr` on `parent` (which must outlive it), returns NULL on failure
+struct i2c_mux *i2c_mux_create(struct I2cBus *parent, uint8_t addr);
+
+/*
+    Bus of downstream `channel` (0-7), with its own bus-owner thread.
+    Close it with i2c_close() before destroying the mux.
+*/
+struct I2cBus *i2c_mux_channel(struct i2c_mux *mux, uint8_t channel);
+
+// Disables every channel and frees the mux
+void i2c_mux_destroy(struct i2c_mux *mux);
+
+#endif /* I2C_MUX_H */
@@ -0,0 +1,679 @@
+#include "i2c_sim.h"
+#include "crc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#define NSEC_PER_SEC 1000000000LL
+
+/****************** Device models ******************/
+
+/* BMP280 */
+#define BMP280_REG_CALIB 0x88
+#define BMP280_REG_ID 0xD0
+#define BMP280_REG_RESET 0xE0
+#define BMP280_REG_STATUS 0xF3
+#define BMP280_REG_CTRL_MEAS 0xF4
+#define BMP280_REG_CONFIG 0xF5
+#define BMP280_REG_DATA 0xF7
+
+#define BMP280_CHIP_ID 0x58
+#define BMP280_RESET_VALUE 0xB6
+#define BMP280_STATUS_MEASURING 0x08
+#define BMP280_MODE_MASK 0x03
+#define BMP280_MODE_FORCED 0x01
+#define BMP280_MODE_NORMAL 0x03
+
+struct sim_bmp280
+{
+    uint8_t regs[256];
+    uint8_t ptr;
+    int32_t adc_T;
+    int32_t adc_P;
+    int64_t ready_at_ns; // end of the running forced conversion (0: idle)
+    unsigned latency_us;
+};
+
+/* HTU21D */
+#define HTU21D_TRIGGER_TEMP_HOLD 0xE3
+#define HTU21D_TRIGGER_HUMID_HOLD 0xE5
+#define HTU21D_TRIGGER_TEMP_NO_HOLD 0xF3
+#define HTU21D_TRIGGER_HUMID_NO_HOLD 0xF5
+#define HTU21D_WRITE_USER_REG 0xE6
+#define HTU21D_READ_USER_REG 0xE7
+#define HTU21D_SOFT_RESET 0xFE
+
+#define HTU21D_USER_REG_DEFAULT 0x02
+#define HTU21D_USER_REG_RO_MASK 0x78 // end-of-battery + reserved bits
+#define HTU21D_SOFT_RESET_NS (15 * 1000000LL)
+
+enum sim_htu21d_state
+{
+    SIM_HTU21D_IDLE,
+    SIM_HTU21D_CONVERTING,
+    SIM_HTU21D_USER_REG,
+};
+
+struct sim_htu21d
+{
+    uint8_t user_reg;
+    uint16_t raw_temp;
+    uint16_t raw_humidity;
+    enum sim_htu21d_state state;
+    bool humidity;  // conversion in progress is RH
+    bool hold;      // hold master: stretch SCL instead of NACK
+    int64_t ready_at_ns;
+    unsigned latency_us;
+};
+
+/* PCF8574 + HD44780 */
+#define PCF_RS 0x01
+#define PCF_RW 0x02
+#define PCF_EN 0x04
+#define HD44780_DDRAM_COLS 40
+#define HD44780_LINE2_ADDR 0x40
+#define HD44780_EXEC_NS 37000LL
+#define HD44780_EXEC_LONG_NS 1520000LL
+
+struct sim_pcf8574
+{
+    uint8_t port;
+
+    bool four_bit;
+    bool have_high; // first nibble of a 4-bit transfer received
+    uint8_t high;
+    bool read_low;  // next status read returns the low nibble
+
+    char ddram[I2C_SIM_LCD_LINES][HD44780_DDRAM_COLS];
+    uint8_t ac;     // address counter
+    int shift;      // display shift, in characters
+    bool increment; // entry mode I/D
+    bool auto_shift; // entry mode S
+    bool cgram;     // data writes go to CGRAM
+    bool display_on;
+    int64_t busy_until_ns;
+
+    unsigned latency_us;
+};
+
+/* TCA9548A: a single control register, one enable bit per channel */
+struct sim_tca9548a
+{
+    uint8_t control;
+};
+
+struct i2c_sim
+{
+    pthread_mutex_t lock;
+    struct sim_tca9548a tca9548a;
+    struct sim_bmp280 bmp280;
+    struct sim_htu21d htu21d;
+    struct sim_pcf8574 pcf8574;
+};
+
+static int64_t sim_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void sim_sleep_until(int64_t deadline_ns)
+{
+    struct timespec ts = {
+        .tv_sec = deadline_ns / NSEC_PER_SEC,
+        .tv_nsec = deadline_ns % NSEC_PER_SEC,
+    };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+}
+
+/****************** BMP280 ******************/
+
+static const uint16_t sim_bmp280_calib[12] = {
+    // Datasheet example values (section 3.12)
+    27504, 26435, (uint16_t)-1000,
+    36477, (uint16_t)-10685, 3024, 2855, 140, (uint16_t)-7, 15500, (uint16_t)-14600, 6000};
+
+static void sim_bmp280_reset(struct sim_bmp280 *dev)
+{
+    memset(dev->regs, 0, sizeof(dev->regs));
+
+    for (int i = 0; i < 12; i++)
+    {
+        dev->regs[BMP280_REG_CALIB + 2 * i] = sim_bmp280_calib[i] & 0xFF;
+        dev->regs[BMP280_REG_CALIB + 2 * i + 1] = sim_bmp280_calib[i] >> 8;
+    }
+
+    dev->regs[BMP280_REG_ID] = BMP280_CHIP_ID;
+
+    // Data registers reset value is 0x80000
+    dev->regs[BMP280_REG_DATA] = 0x80;
+    dev->regs[BMP280_REG_DATA + 3] = 0x80;
+
+    dev->ready_at_ns = 0;
+}
+
+static void sim_bmp280_latch_data(struct sim_bmp280 *dev)
+{
+    uint8_t *d = &dev->regs[BMP280_REG_DATA];
+
+    d[0] = (dev->adc_P >> 12) & 0xFF;
+    d[1] = (dev->adc_P >> 4) & 0xFF;
+    d[2] = (dev->adc_P << 4) & 0xF0;
+    d[3] = (dev->adc_T >> 12) & 0xFF;
+    d[4] = (dev->adc_T >> 4) & 0xFF;
+    d[5] = (dev->adc_T << 4) & 0xF0;
+}
+
+// Datasheet 3.8.1: t_meas,max = 1.25 + 2.3 * T_os + (2.3 * P_os + 0.575) ms
+static int64_t sim_bmp280_conversion_ns(uint8_t ctrl_meas)
+{
+    static const int os[8] = {0, 1, 2, 4, 8, 16, 16, 16};
+    int t_os = os[(ctrl_meas >> 5) & 0x07];
+    int p_os = os[(ctrl_meas >> 2) & 0x07];
+
+    int64_t us = 1250 + 2300 * t_os;
+    if (p_os)
+        us += 2300 * p_os + 575;
+
+    return us * 1000;
+}
+
+// Bring the register file up to date with the current time
+static void sim_bmp280_update(struct sim_bmp280 *dev, int64_t now)
+{
+    uint8_t mode = dev->regs[BMP280_REG_CTRL_MEAS] & BMP280_MODE_MASK;
+
+    if (mode == BMP280_MODE_NORMAL)
+    {
+        sim_bmp280_latch_data(dev);
+        return;
+    }
+
+    if (dev->ready_at_ns && now >= dev->ready_at_ns)
+    {
+        // Forced conversion done: results latched, back to sleep mode
+        sim_bmp280_latch_data(dev);
+        dev->ready_at_ns = 0;
+        dev->regs[BMP280_REG_CTRL_MEAS] &= ~BMP280_MODE_MASK;
+    }
+
+    if (dev->ready_at_ns)
+        dev->regs[BMP280_REG_STATUS] |= BMP280_STATUS_MEASURING;
+    else
+        dev->regs[BMP280_REG_STATUS] &= ~BMP280_STATUS_MEASURING;
+}
+
+static int sim_bmp280_write(struct sim_bmp280 *dev, const uint8_t *buf, size_t len, int64_t now)
+{
+    dev->ptr = buf[0];
+
+    // Register writes come as (address, value) pairs
+    for (size_t i = 0; i + 1 < len; i += 2)
+    {
+        uint8_t reg = buf[i];
+        uint8_t val = buf[i + 1];
+
+        if (reg == BMP280_REG_RESET)
+        {
+            if (val == BMP280_RESET_VALUE)
+                sim_bmp280_reset(dev);
+            continue;
+        }
+
+        if (reg != BMP280_REG_CTRL_MEAS && reg != BMP280_REG_CONFIG)
+            continue; // read-only
+
+        dev->regs[reg] = val;
+
+        if (reg == BMP280_REG_CTRL_MEAS && (val & BMP280_MODE_MASK) == BMP280_MODE_FORCED)
+            dev->ready_at_ns = now + sim_bmp280_conversion_ns(val);
+    }
+
+    sim_bmp280_update(dev, now);
+    return 0;
+}
+
+static int sim_bmp280_read(struct sim_bmp280 *dev, uint8_t *buf, size_t len, int64_t now)
+{
+    sim_bmp280_update(dev, now);
+
+    for (size_t i = 0; i < len; i++)
+        buf[i] = dev->regs[(uint8_t)(dev->ptr + i)];
+
+    return 0;
+}
+
+/****************** HTU21D ******************/
+
+// Datasheet max conversion times for the four resolution settings
+static int64_t sim_htu21d_conversion_ns(const struct sim_htu21d *dev)
+{
+    static const int64_t temp_ms[4] = {50, 13, 25, 7};  // 14, 12, 13, 11 bit
+    static const int64_t humid_ms[4] = {16, 3, 5, 8};   // 12, 8, 10, 11 bit
+    int res = ((dev->user_reg >> 6) & 0x02) | (dev->user_reg & 0x01);
+
+    return (dev->humidity ? humid_ms[res] : temp_ms[res]) * 1000000LL;
+}
+
+static int sim_htu21d_write(struct sim_htu21d *dev, const uint8_t *buf, size_t len, int64_t now)
+{
+    // Still running its soft reset: address NACK
+    if (dev->state == SIM_HTU21D_IDLE && now < dev->ready_at_ns)
+        return -EREMOTEIO;
+
+    switch (buf[0])
+    {
+    case HTU21D_TRIGGER_TEMP_HOLD:
+    case HTU21D_TRIGGER_HUMID_HOLD:
+    case HTU21D_TRIGGER_TEMP_NO_HOLD:
+    case HTU21D_TRIGGER_HUMID_NO_HOLD:
+        dev->humidity = (buf[0] == HTU21D_TRIGGER_HUMID_HOLD || buf[0] == HTU21D_TRIGGER_HUMID_NO_HOLD);
+        dev->hold = (buf[0] == HTU21D_TRIGGER_TEMP_HOLD || buf[0] == HTU21D_TRIGGER_HUMID_HOLD);
+        dev->state = SIM_HTU21D_CONVERTING;
+        dev->ready_at_ns = now + sim_htu21d_conversion_ns(dev);
+        return 0;
+
+    case HTU21D_READ_USER_REG:
+        dev->state = SIM_HTU21D_USER_REG;
+        return 0;
+
+    case HTU21D_WRITE_USER_REG:
+        if (len < 2)
+            return -EIO;
+        dev->user_reg = (dev->user_reg & HTU21D_USER_REG_RO_MASK) | (buf[1] & ~HTU21D_USER_REG_RO_MASK);
+        dev->state = SIM_HTU21D_IDLE;
+        return 0;
+
+    case HTU21D_SOFT_RESET:
+        dev->user_reg = HTU21D_USER_REG_DEFAULT;
+        dev->state = SIM_HTU21D_IDLE;
+        dev->ready_at_ns = now + HTU21D_SOFT_RESET_NS;
+        return 0;
+
+    default:
+        return -EREMOTEIO;
+    }
+}
+
+static int sim_htu21d_read(struct sim_htu21d *dev, uint8_t *buf, size_t len, int64_t now)
+{
+    if (dev->state == SIM_HTU21D_USER_REG)
+    {
+        buf[0] = dev->user_reg;
+        for (size_t i = 1; i < len; i++)
+            buf[i] = 0xFF;
+        return 0;
+    }
+
+    if (dev->state != SIM_HTU21D_CONVERTING)
+        return -EREMOTEIO;
+
+    if (now < dev->ready_at_ns)
+    {
+        if (!dev->hold)
+            return -EREMOTEIO; // no-hold: NACK until the conversion is done
+
+        sim_sleep_until(dev->ready_at_ns); // hold: clock stretching
+    }
+
+    uint16_t raw = dev->humidity ? (dev->raw_humidity & 0xFFFC) | 0x02 : (dev->raw_temp & 0xFFFC);
+    uint8_t data[3] = {raw >> 8, raw & 0xFF, 0};
+    data[2] = compute_crc8(data, 2);
+
+    for (size_t i = 0; i < len; i++)
+        buf[i] = (i < 3) ? data[i] : 0xFF;
+
+    dev->state = SIM_HTU21D_IDLE;
+    dev->ready_at_ns = 0;
+    return 0;
+}
+
+/****************** PCF8574 + HD44780 ******************/
+
+static void sim_lcd_clear(struct sim_pcf8574 *dev)
+{
+    memset(dev->ddram, ' ', sizeof(dev->ddram));
+    dev->ac = 0;
+    dev->shift = 0;
+    dev->increment = true;
+}
+
+static void sim_lcd_advance(struct sim_pcf8574 *dev)
+{
+    int line = (dev->ac >= HD44780_LINE2_ADDR) ? 1 : 0;
+    int col = dev->ac - line * HD44780_LINE2_ADDR;
+
+    col += dev->increment ? 1 : -1;
+
+    // 2-line mode: the address counter wraps from the end of one line to the other
+    if (col >= HD44780_DDRAM_COLS)
+    {
+        col = 0;
+        line ^= 1;
+    }
+    else if (col < 0)
+    {
+        col = HD44780_DDRAM_COLS - 1;
+        line ^= 1;
+    }
+
+    dev->ac = line * HD44780_LINE2_ADDR + col;
+
+    if (dev->auto_shift)
+        dev->shift += dev->increment ? 1 : -1;
+}
+
+static void sim_lcd_execute(struct sim_pcf8574 *dev, uint8_t value, bool rs, int64_t now)
+{
+    int64_t exec_ns = HD44780_EXEC_NS;
+
+    if (rs)
+    {
+        if (!dev->cgram)
+        {
+            int line = (dev->ac >= HD44780_LINE2_ADDR) ? 1 : 0;
+            int col = dev->ac - line * HD44780_LINE2_ADDR;
+
+            if (col < HD44780_DDRAM_COLS)
+                dev->ddram[line][col] = (char)value;
+        }
+        sim_lcd_advance(dev);
+    }
+    else if (value & 0x80) // set DDRAM address
+    {
+        dev->ac = value & 0x7F;
+        dev->cgram = false;
+    }
+    else if (value & 0x40) // set CGRAM address
+    {
+        dev->cgram = true;
+    }
+    else if (value & 0x20) // function set
+    {
+        dev->four_bit = !(value & 0x10);
+    }
+    else if (value & 0x10) // cursor/display shift
+    {
+        if (value & 0x08)
+            dev->shift += (value & 0x04) ? -1 : 1;
+    }
+    else if (value & 0x08) // display on/off control
+    {
+        dev->display_on = value & 0x04;
+    }
+    else if (value & 0x04) // entry mode set
+    {
+        dev->increment = value & 0x02;
+        dev->auto_shift = value & 0x01;
+    }
+    else if (value & 0x02) // return home
+    {
+        dev->ac = 0;
+        dev->shift = 0;
+        exec_ns = HD44780_EXEC_LONG_NS;
+    }
+    else if (value & 0x01) // clear display
+    {
+        sim_lcd_clear(dev);
+        exec_ns = HD44780_EXEC_LONG_NS;
+    }
+
+    dev->shift = ((dev->shift % HD44780_DDRAM_COLS) + HD44780_DDRAM_COLS) % HD44780_DDRAM_COLS;
+    dev->busy_until_ns = now + exec_ns;
+}
+
+// HD44780 samples the data bus on the falling edge of EN
+static void sim_lcd_latch(struct sim_pcf8574 *dev, uint8_t port, int64_t now)
+{
+    uint8_t nibble = port & 0xF0;
+    bool rs = port & PCF_RS;
+
+    if (port & PCF_RW)
+    {
+        // Read cycle: nothing to latch, the next strobe reads the other nibble
+        dev->read_low = !dev->read_low;
+        return;
+    }
+
+    dev->read_low = false;
+
+    if (!dev->four_bit)
+    {
+        // 8-bit interface, D0-D3 not wired: the nibble is the whole instruction
+        dev->have_high = false;
+        sim_lcd_execute(dev, nibble, rs, now);
+        return;
+    }
+
+    if (!dev->have_high)
+    {
+        dev->high = nibble;
+        dev->have_high = true;
+        return;
+    }
+
+    dev->have_high = false;
+    sim_lcd_execute(dev, dev->high | (nibble >> 4), rs, now);
+}
+
+static int sim_pcf8574_write(struct sim_pcf8574 *dev, const uint8_t *buf, size_t len, int64_t now)
+{
+    // Every byte of a multi-byte write is latched on the outputs in turn
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t prev = dev->port;
+        dev->port = buf[i];
+
+        if ((prev & PCF_EN) && !(dev->port & PCF_EN))
+            sim_lcd_latch(dev, prev, now);
+    }
+
+    return 0;
+}
+
+static int sim_pcf8574_read(struct sim_pcf8574 *dev, uint8_t *buf, size_t len, int64_t now)
+{
+    uint8_t value = dev->port;
+
+    // RS=0, RW=1, EN=1: the HD44780 drives BF/address counter on D4-D7
+    if ((dev->port & (PCF_RW | PCF_EN)) == (PCF_RW | PCF_EN) && !(dev->port & PCF_RS))
+    {
+        uint8_t status = (now < dev->busy_until_ns ? 0x80 : 0x00) | (dev->ac & 0x7F);
+        uint8_t nibble = dev->read_low ? (status << 4) : (status & 0xF0);
+
+        value = (dev->port & 0x0F) | (nibble & dev->port & 0xF0);
+    }
+
+    for (size_t i = 0; i < len; i++)
+        buf[i] = value;
+
+    return 0;
+}
+
+/****************** Backend ******************/
+
+void *i2c_sim_open(void)
+{
+    struct i2c_sim *sim = (struct i2c_sim *)calloc(1, sizeof(struct i2c_sim));
+
+    if (!sim)
+        return NULL;
+
+    pthread_mutex_init(&sim->lock, NULL);
+
+    // Datasheet example: 25.08 degC, 100653 Pa
+    sim->bmp280.adc_T = 519888;
+    sim->bmp280.adc_P = 415148;
+    sim_bmp280_reset(&sim->bmp280);
+
+    // About 26 degC and 46 %RH
+    sim->htu21d.raw_temp = 0x6A00;
+    sim->htu21d.raw_humidity = 0x6A3C;
+    sim->htu21d.user_reg = HTU21D_USER_REG_DEFAULT;
+
+    sim_lcd_clear(&sim->pcf8574);
+
+    return sim;
+}
+
+static unsigned sim_latency_us(struct i2c_sim *sim, uint8_t addr)
+{
+    switch (addr)
+    {
+    case I2C_SIM_BMP280_ADDR:
+        return sim->bmp280.latency_us;
+    case I2C_SIM_HTU21D_ADDR:
+        return sim->htu21d.latency_us;
+    case I2C_SIM_PCF8574_ADDR:
+        return sim->pcf8574.latency_us;
+    default:
+        return 0;
+    }
+}
+
+static int sim_dispatch(struct i2c_sim *sim, struct I2cMsg *msg, int64_t now)
+{
+    bool rd = msg->flags & I2C_MSG_READ;
+
+    if (msg->len == 0)
+        return -EINVAL;
+
+    switch (msg->addr)
+    {
+    case I2C_SIM_TCA9548A_ADDR:
+        // Write: the last byte sets the channels; read: the register back
+        if (rd)
+            memset(msg->buf, sim->tca9548a.control, msg->len);
+        else
+            sim->tca9548a.control = msg->buf[msg->len - 1];
+        return 0;
+    case I2C_SIM_BMP280_ADDR:
+        return rd ? sim_bmp280_read(&sim->bmp280, msg->buf, msg->len, now)
+                  : sim_bmp280_write(&sim->bmp280, msg->buf, msg->len, now);
+    case I2C_SIM_HTU21D_ADDR:
+        return rd ? sim_htu21d_read(&sim->htu21d, msg->buf, msg->len, now)
+                  : sim_htu21d_write(&sim->htu21d, msg->buf, msg->len, now);
+    case I2C_SIM_PCF8574_ADDR:
+        return rd ? sim_pcf8574_read(&sim->pcf8574, msg->buf, msg->len, now)
+                  : sim_pcf8574_write(&sim->pcf8574, msg->buf, msg->len, now);
+    default:
+        return -EREMOTEIO; // nobody acknowledged the address
+    }
+}
+
+static int i2c_sim_transfer(void *backend, struct I2cMsg *msgs, size_t count, bool combined)
+{
+    struct i2c_sim *sim = (struct i2c_sim *)backend;
+    int ret = 0;
+
+    (void)combined; // the model has no other master, STOP vs repeated-start is irrelevant
+
+    pthread_mutex_lock(&sim->lock);
+
+    unsigned latency_us = sim_latency_us(sim, msgs[0].addr);
+
+    for (size_t i = 0; i < count && ret == 0; i++)
+        ret = sim_dispatch(sim, &msgs[i], sim_now_ns());
+
+    pthread_mutex_unlock(&sim->lock);
+
+    if (latency_us)
+        sim_sleep_until(sim_now_ns() + (int64_t)latency_us * 1000);
+
+    return ret;
+}
+
+static void i2c_sim_close(void *backend)
+{
+    struct i2c_sim *sim = (struct i2c_sim *)backend;
+
+    pthread_mutex_destroy(&sim->lock);
+    free(sim);
+}
+
+const struct i2c_backend_ops i2c_sim_ops = {
+    .name = "sim",
+    .transfer = i2c_sim_transfer,
+    .close = i2c_sim_close,
+};
+
+/****************** Test hooks ******************/
+
+bool i2c_sim_is_simulated(struct I2cBus *bus)
+{
+    return bus && bus->ops == &i2c_sim_ops;
+}
+
+void i2c_sim_set_latency(struct I2cBus *bus, uint8_t addr, unsigned latency_us)
+{
+    if (!i2c_sim_is_simulated(bus))
+        return;
+
+    struct i2c_sim *sim = (struct i2c_sim *)bus->backend;
+
+    pthread_mutex_lock(&sim->lock);
+    switch (addr)
+    {
+    case I2C_SIM_BMP280_ADDR:
+        sim->bmp280.latency_us = latency_us;
+        break;
+    case I2C_SIM_HTU21D_ADDR:
+        sim->htu21d.latency_us = latency_us;
+        break;
+    case I2C_SIM_PCF8574_ADDR:
+        sim->pcf8574.latency_us = latency_us;
+        break;
+    default:
+        break;
+    }
+    pthread_mutex_unlock(&sim->lock);
+}
+
+void i2c_sim_bmp280_set_raw(struct I2cBus *bus, int32_t adc_T, int32_t adc_P)
+{
+    if (!i2c_sim_is_simulated(bus))
+        return;
+
+    struct i2c_sim *sim = (struct i2c_sim *)bus->backend;
+
+    pthread_mutex_lock(&sim->lock);
+    sim->bmp280.adc_T = adc_T & 0xFFFFF;
+    sim->bmp280.adc_P = adc_P & 0xFFFFF;
+    pthread_mutex_unlock(&sim->lock);
+}
+
+void i2c_sim_htu21d_set_raw(struct I2cBus *bus, uint16_t raw_temp, uint16_t raw_humidity)
+{
+    if (!i2c_sim_is_simulated(bus))
+        return;
+
+    struct i2c_sim *sim = (struct i2c_sim *)bus->backend;
+
+    pthread_mutex_lock(&sim->lock);
+    sim->htu21d.raw_temp = raw_temp;
+    sim->htu21d.raw_humidity = raw_humidity;
+    pthread_mutex_unlock(&sim->lock);
+}
+
+void i2c_sim_lcd_read(struct I2cBus *bus, char lines[I2C_SIM_LCD_LINES][I2C_SIM_LCD_COLS + 1])
+{
+    if (!i2c_sim_is_simulated(bus))
+        return;
+
+    struct i2c_sim *sim = (struct i2c_sim *)bus->backend;
+    struct sim_pcf8574 *lcd = &sim->pcf8574;
+
+    pthread_mutex_lock(&sim->lock);
+    for (int line = 0; line < I2C_SIM_LCD_LINES; line++)
+    {
+        for (int col = 0; col < I2C_SIM_LCD_COLS; col++)
+            lines[line][col] = lcd->display_on ? lcd->ddram[line][(lcd->shift + col) % HD44780_DDRAM_COLS] : ' ';
+        lines[line][I2C_SIM_LCD_COLS] = '\0';
+    }
+    pthread_mutex_unlock(&sim->lock);
+}
@@ -0,0 +1,51 @@
+#ifndef I2C_SIM_H
+#define I2C_SIM_H
+
+/*
+    In-memory I2C backend used to run and profile the whole pipeline off-target.
+
+    Simulated devices (at their default addresses):
+    - BMP280 (0x76): register map with datasheet calibration at 0x88,
+      data at 0xF7, ctrl_meas/config/status and forced mode timing
+    - HTU21D (0x40): hold/no-hold commands (no-hold reads NACK until the
+      conversion is done), user register, soft reset and CRC
+    - PCF8574 (0x27): decodes the HD44780 4-bit nibble protocol into a
+      virtual 16x2 screen (40 characters of DDRAM per line), with busy
+      flag/address counter read-back
+    - TCA9548A (0x70): control register only, the devices above answer
+      whatever channels are enabled
+*/
+
+#include "i2c.h"
+
+#define I2C_SIM_PATH "sim"
+
+#define I2C_SIM_BMP280_ADDR 0x76
+#define I2C_SIM_HTU21D_ADDR 0x40
+#define I2C_SIM_PCF8574_ADDR 0x27
+#define I2C_SIM_TCA9548A_ADDR 0x70
+
+#define I2C_SIM_LCD_COLS 16
+#define I2C_SIM_LCD_LINES 2
+
+extern const struct i2c_backend_ops i2c_sim_ops;
+
+// Create a simulated bus, returns the backend handle or NULL
+void *i2c_sim_open(void);
+
+// True if `bus` runs on the simulated backend (the helpers below are no-ops otherwise)
+bool i2c_sim_is_simulated(struct I2cBus *bus);
+
+// Extra time spent in every transaction addressed to `addr` (models bus/device time)
+void i2c_sim_set_latency(struct I2cBus *bus, uint8_t addr, unsigned latency_us);
+
+// Raw ADC values returned by the simulated BMP280 (20-bit)
+void i2c_sim_bmp280_set_raw(struct I2cBus *bus, int32_t adc_T, int32_t adc_P);
+
+// Raw 16-bit values returned by the simulated HTU21D (status bits are set by the model)
+void i2c_sim_htu21d_set_raw(struct I2cBus *bus, uint16_t raw_temp, uint16_t raw_humidity);
+
+// Copy the visible part of the virtual LCD (NUL-terminated lines)
+void i2c_sim_lcd_read(struct I2cBus *bus, char lines[I2C_SIM_LCD_LINES][I2C_SIM_LCD_COLS + 1]);
+
+#endif /* I2C_SIM_H */
@@ -8,22 +8,35 @@
 #include <sys/types.h>
 #include <string.h>
 
-#include "htu21d.h"
-#include "bmp280.h"
 #include "db.h"
+#include "db_sqlite.h"
+#include "db_segment.h"
+#include "history.h"
+#include "sensor_snapshot.h"
+#include "pipeline.h"
+#include "scheduler.h"
+#include "event_loop.h"
 #include "display.h"
+#include "i2c_sim.h"
+#include "device_registry.h"
+#include "acquisition.h"
+#include "i2c_capture.h"
+#include "replay.h"
 
 #define I2C_BUS "/dev/i2c-1"
 #define DB_FILE "/var/lib/pi-home-sensors_data/data.db"
-#define DB_DATA_SIZE 100
+#define DB_DATA_SIZE 400 // raw rows, at least one archive block (see sensors_db_policy)
+#define DB_SEGMENTS_DIR "/var/lib/pi-home-sensors_data/segments"
+#define DB_SEGMENTS_MAX 512 // 1 MiB each, about 4.5 months of the default station
 
-volatile sig_atomic_t keep_running = 1; // Flag for shutdown
+// Replay output, recreated on every run so benchmarks start from the same state
+#define DB_REPLAY_FILE "/var/lib/pi-home-sensors_data/replay.db"
+#define DB_REPLAY_SEGMENTS_DIR "/var/lib/pi-home-sensors_data/replay-segments"
 
-void handle_signal(int signal)
-{
-    printf("\nCaught signal %d. Shutting down...\n", signal);
-    keep_running = 0; // Change flag to exit the loop
-}
+// In-memory history: 1 min buckets over 34 h, last hour of raw samples
+#define HISTORY_BUCKET_MS (60 * 1000)
+#define HISTORY_BUCKETS 2048
+#define HISTORY_RECENT 4096
 
 /*
 Double Fork Steps
@@ -74,72 +87,186 @@ void daemonize(void)
     close(STDERR_FILENO);
 }
 
-// Function to handle sensor reading and storage
-void sensors_update(struct bmp280 *bmp280_sens,
-                    struct htu21d *htu21d_sens, struct sensors_db *sens_db, struct htu21d_measurement *temperature, struct htu21d_measurement *humidity,
-                    float *bmp280_temp, float *bmp280_pressure,
-                    int verbose)
+#define STATUS_PERIOD_NS (10 * 1000LL * 1000 * 1000)   // verbose report
+#define WELCOME_NS (3 * 1000LL * 1000 * 1000)          // welcome screen before the first readings
+
+// What the main loop's status task reports on
+struct status
 {
+    struct sensors_history *history;
+    struct event_loop *loop;
+    struct scheduler *sched;
+    struct I2cBus *display_bus; // simulated LCD contents, NULL if none
+};
+
+// SIGINT/SIGTERM: leave the event loop (ordinary callback, not signal context)
+static void signal_event(struct event_source *src, uint32_t events)
+{
+    (void)events;
 
-    if (bmp280_get_measurement(bmp280_sens, bmp280_temp, bmp280_pressure) == 0)
-    {
-        if (verbose)
-        {
-            printf("BMP280 temperature: %.2f °C\n", *bmp280_temp);
-            printf("BMP280 pressure: %.2f hPa\n", *bmp280_pressure);
-        }
+    printf("\nCaught signal %d. Shutting down...\n", src->signo);
+    event_loop_stop((struct event_loop *)src->arg);
+}
 
-        *temperature = htu21d_read_temperature_no_hold(htu21d_sens);
-        *humidity = htu21d_read_humidity_no_hold(htu21d_sens);
+// Verbose report: history and main loop statistics (each acquisition worker reports its bus)
+static void status_task(struct sched_task *task, const struct timespec *deadline)
+{
+    struct status *status = (struct status *)task->arg;
 
-        if (temperature->is_valid && humidity->is_valid)
-        {
-            if (verbose)
-            {
-                printf("HTU21D temperature: %.2f °C\n", temperature->value);
-                printf("HTU21D humidity: %.2f %%RH\n", humidity->value);
-            }
-
-            if (sensors_db_store_data(sens_db, *bmp280_temp, *bmp280_pressure,
-                                      temperature->value, humidity->value) == 0)
-            {
-                if (verbose)
-                    printf("Sensors data stored successfully\n");
-            }
-        }
-        else if (verbose)
-        {
-            printf("Invalid HTU21D data: temp valid = %d, humidity valid = %d\n",
-                   temperature->is_valid, humidity->is_valid);
-        }
+    (void)deadline;
+
+    struct sensors_history_stats day[SENSORS_DB_CHANNELS];
+    int64_t now_ms = sensors_db_now_ms();
+    if (sensors_history_query(status->history, now_ms - 24 * 3600 * 1000LL, now_ms, day) > 0)
+        printf("Last 24 h: T %.2f..%.2f °C (mean %.2f), RH %.1f..%.1f %%, P %.1f..%.1f hPa\n",
+               day[2].min, day[2].max, day[2].mean, day[3].min, day[3].max, day[1].min, day[1].max);
+
+    printf("Event loop: %llu wakeups, %llu callbacks\n",
+           (unsigned long long)status->loop->waits, (unsigned long long)status->loop->dispatched);
+
+    for (size_t i = 0; i < status->sched->count; i++)
+    {
+        const struct sched_task *t = status->sched->heap[i];
+        printf("Task %s: %llu runs, %llu missed deadlines, max %.3f ms late\n", t->name,
+               (unsigned long long)t->runs, (unsigned long long)t->missed, t->max_late_ns / 1e6);
+    }
+
+    if (status->display_bus && i2c_sim_is_simulated(status->display_bus))
+    {
+        char lcd[I2C_SIM_LCD_LINES][I2C_SIM_LCD_COLS + 1];
+        i2c_sim_lcd_read(status->display_bus, lcd);
+        printf("LCD: [%s]\n     [%s]\n", lcd[0], lcd[1]);
     }
 }
 
-void print_sensor_data(float bmp280_temp, float bmp280_pressure,
-                       struct htu21d_measurement *temperature, struct htu21d_measurement *humidity)
+// Format a sample for the LCD (pipeline presentation stage), `arg` is the display
+void print_sensor_data(const struct sensors_sample *sample, void *arg)
 {
+    struct display *display = (struct display *)arg;
     char info_msg_l1[MAX_PRINT_SIZE];
     char info_msg_l2[MAX_PRINT_SIZE];
 
-    snprintf(info_msg_l1, MAX_PRINT_SIZE, "T=%.1fC|P=%dkPa", bmp280_temp, (int)(bmp280_pressure) / 10);
-    display_print(info_msg_l1, 0);
+    if (!display)
+        return;
 
-    if (temperature->is_valid && humidity->is_valid)
+    if (sample->valid & SENSORS_SAMPLE_BMP280)
+        snprintf(info_msg_l1, MAX_PRINT_SIZE, "T=%.1fC|P=%dkPa", sample->values[0], (int)(sample->values[1]) / 10);
+    else
+        snprintf(info_msg_l1, MAX_PRINT_SIZE, "BMP280: Invalid data");
+    display_print(display, info_msg_l1, 0);
+
+    if ((sample->valid & SENSORS_SAMPLE_HTU21D_TEMP) && (sample->valid & SENSORS_SAMPLE_HTU21D_HUMIDITY))
     {
-        snprintf(info_msg_l2, MAX_PRINT_SIZE, "T=%.2fC|H=%d%%", temperature->value, (int)(humidity->value));
-        display_print(info_msg_l2, 1);
+        snprintf(info_msg_l2, MAX_PRINT_SIZE, "T=%.2fC|H=%d%%", sample->values[2], (int)(sample->values[3]));
+        display_print(display, info_msg_l2, 1);
     }
     else
     {
         snprintf(info_msg_l2, MAX_PRINT_SIZE, "HTU21D: Invalid data");
-        display_print(info_msg_l2, 1);
+        display_print(display, info_msg_l2, 1);
     }
 }
 
+// Record what each device id stands for next to the samples
+static void describe_devices(struct sensors_db *db, const struct device_registry *registry)
+{
+    for (size_t i = 0; i < registry->count; i++)
+    {
+        const struct device_config *config = &registry->devices[i];
+        struct sensors_device_info info = {
+            .id = config->id,
+            .name = config->name,
+            .driver = device_driver_name(config->driver),
+            .bus = config->bus_path,
+            .address = config->address,
+            .mux_address = config->mux_address,
+            .mux_channel = config->mux_channel,
+        };
+
+        if (sensors_db_describe_device(db, &info) < 0)
+            fprintf(stderr, "Failed to record device %u (%s)\n", (unsigned)config->id, config->name);
+    }
+}
+
+// Open the store, binary segments or SQLite at `db_file` (WAL, one commit per minute of samples)
+static struct sensors_db *open_store(int binary_store, char *db_file, char *segments_dir)
+{
+    if (binary_store)
+        return sensors_db_init_backend(&sensors_db_segment_ops,
+                                       sensors_db_segment_open(segments_dir, SENSORS_DB_SEGMENT_BLOCKS, DB_SEGMENTS_MAX));
+
+    struct sensors_db_policy db_policy = SENSORS_DB_POLICY_DEFAULT;
+    return sensors_db_init(db_file, DB_DATA_SIZE, &db_policy);
+}
+
+// --speed N|max: times the captured pace, or REPLAY_SPEED_MAX
+static int parse_speed(const char *arg, double *speed)
+{
+    char *end;
+
+    if (strcmp(arg, "max") == 0)
+    {
+        *speed = REPLAY_SPEED_MAX;
+        return 0;
+    }
+
+    *speed = strtod(arg, &end);
+
+    return (end != arg && *end == '\0' && *speed > 0) ? 0 : -1;
+}
+
+// --replay: feed a capture through the decode and storage paths, report throughput
+static int run_replay(const struct device_registry *registry, const char *path, double speed, int binary_store)
+{
+    struct replay_stats stats;
+
+    // Every run starts from an empty store, so that runs over the same capture compare
+    if (binary_store)
+    {
+        if (sensors_db_segment_clear(DB_REPLAY_SEGMENTS_DIR) < 0)
+        {
+            fprintf(stderr, "Failed to clear the replay segments\n");
+            return EXIT_FAILURE;
+        }
+    }
+    else
+    {
+        unlink(DB_REPLAY_FILE);
+        unlink(DB_REPLAY_FILE "-wal");
+        unlink(DB_REPLAY_FILE "-shm");
+    }
+
+    struct sensors_db *db = open_store(binary_store, DB_REPLAY_FILE, DB_REPLAY_SEGMENTS_DIR);
+    if (!db)
+    {
+        fprintf(stderr, "Failed to open the replay store\n");
+        return EXIT_FAILURE;
+    }
+
+    describe_devices(db, registry);
+
+    struct sensors_history *history = sensors_history_create(HISTORY_BUCKET_MS, HISTORY_BUCKETS, HISTORY_RECENT);
+
+    int ret = replay_run(registry, path, speed, db, history, &stats);
+    if (ret == 0)
+        replay_print_stats(&stats);
+
+    sensors_db_close(db);
+    sensors_history_destroy(history);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, char *argv[])
 {
     int daemon_mode = 0;
     int verbose = 0;
+    int binary_store = 0;
+    bool simulate = false;
+    const char *config_path = NULL;
+    const char *capture_path = NULL;
+    const char *replay_path = NULL;
+    double replay_speed = 1.0;
 
     // Parse command line arguments
     for (int i = 1; i < argc; i++)
@@ -148,65 +275,164 @@ int main(int argc, char *argv[])
             daemon_mode = 1;
         else if (strcmp(argv[i], "-v") == 0)
             verbose = 1;
+        else if (strcmp(argv[i], "-s") == 0)
+            simulate = true; // simulated devices, no hardware needed
+        else if (strcmp(argv[i], "-b") == 0)
+            binary_store = 1; // append-only segment files instead of SQLite
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            config_path = argv[++i]; // device registry, see device_registry.h
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+            capture_path = argv[++i]; // log every I2C transaction, see i2c_capture.h
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replay_path = argv[++i]; // no hardware: decode and store a capture, see replay.h
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc && parse_speed(argv[i + 1], &replay_speed) == 0)
+            i++;
         else
         {
-            fprintf(stderr, "Usage: %s [-d] [-v]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-d] [-v] [-s] [-b] [-c FILE] [--capture FILE]\n"
+                            "       %s [-b] [-c FILE] --replay FILE [--speed N|max]\n",
+                    argv[0], argv[0]);
             return EXIT_FAILURE;
         }
     }
 
+    // Devices from the config file, or the original single-bus station
+    static struct device_registry registry;
+    device_registry_init(&registry);
+    if ((config_path ? device_registry_load(&registry, config_path) : device_registry_add_defaults(&registry, I2C_BUS)) < 0)
+        return EXIT_FAILURE;
+
+    if (replay_path)
+        return run_replay(&registry, replay_path, replay_speed, binary_store);
+
+    // Opened before daemonize() changes the working directory
+    if (capture_path && !(registry.capture = i2c_capture_log_open(capture_path)))
+        return EXIT_FAILURE;
+
     if (daemon_mode)
         daemonize();
 
-    // Set up signal handlers for SIGINT and SIGTERM
-    signal(SIGINT, handle_signal);
-    signal(SIGTERM, handle_signal);
-
-    struct I2cBus *i2c_bus = i2c_init(I2C_BUS);
+    /*
+        The main loop runs the display and the signals, each bus has its
+        own acquisition worker. SIGINT/SIGTERM are blocked and read from a
+        signalfd: done before any thread starts so that they all inherit
+        the mask and the signals only ever reach the main loop.
+    */
+    struct event_loop loop;
+    if (event_loop_init(&loop) < 0)
+        return EXIT_FAILURE;
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+
+    struct event_source signal_src = {.cb = signal_event, .arg = &loop};
+    if (event_loop_add_signals(&loop, &signal_src, &signals) < 0)
+    {
+        event_loop_destroy(&loop);
+        return EXIT_FAILURE;
+    }
 
-    if (!i2c_bus)
+    if (device_registry_open(&registry, simulate) < 0)
     {
-        perror("Failed to initialize I2C bus");
-        return -1;
+        event_loop_remove(&loop, &signal_src);
+        event_loop_destroy(&loop);
+        i2c_capture_log_close(registry.capture);
+        return EXIT_FAILURE;
     }
 
-    display_create(i2c_bus);
-    display_print("   Welcome to   ", 0);
-    display_print("pi-home-sensors", 1);
-    sleep(3);
+    // Shown until the first readings come in (the sensor tasks start after WELCOME_NS)
+    struct device_config *lcd = device_registry_find(&registry, DEVICE_DRIVER_LCD1602);
+    struct display *display = lcd ? display_create(lcd->i2c_bus, lcd->address, &loop) : NULL;
+    display_print(display, "   Welcome to   ", 0);
+    display_print(display, "pi-home-sensors", 1);
+
+    // Initialize the store: SQLite (WAL, one commit per minute of samples) or binary segments
+    struct sensors_db *sens_db = open_store(binary_store, DB_FILE, DB_SEGMENTS_DIR);
+
+    if (sens_db)
+        describe_devices(sens_db, &registry);
 
-    // Initialize sensors
-    struct bmp280 *bmp280_sens = bmp280_init(i2c_bus);
-    float bmp280_temp, bmp280_pressure;
+    struct sensors_history *history = sensors_history_create(HISTORY_BUCKET_MS, HISTORY_BUCKETS, HISTORY_RECENT);
 
-    struct htu21d *htu21d_sens = htu21d_init(i2c_bus);
-    struct htu21d_measurement temperature, humidity;
+    // Latest readings, readable from any thread without locking
+    static struct sensor_snapshot_cell latest;
+    sensor_snapshot_init(&latest);
 
-    // Initialize SQLite database
-    struct sensors_db *sens_db = sensors_db_init(DB_FILE, DB_DATA_SIZE);
+    // Storage and presentation run on their own threads, fed through an SPSC ring and the snapshot
+    struct pipeline *pipeline = pipeline_start(sens_db, history, &latest, print_sensor_data, display, verbose);
+    if (!pipeline)
+        fprintf(stderr, "Failed to start the sample pipeline\n");
 
-    // Main measurement loop
-    while (keep_running)
+    // One worker per bus, each device on its own period on absolute deadlines
+    struct acquisition *acq = NULL;
+    if (pipeline)
     {
-        sensors_update(bmp280_sens, htu21d_sens, sens_db, &temperature, &humidity, &bmp280_temp, &bmp280_pressure, verbose);
+        acq = acquisition_start(&registry, pipeline, &latest, WELCOME_NS, verbose);
+        if (!acq)
+            fprintf(stderr, "Failed to start the acquisition\n");
+    }
+
+    struct scheduler sched = {0};
+    struct status status = {
+        .history = history,
+        .loop = &loop,
+        .sched = &sched,
+        .display_bus = lcd ? lcd->i2c_bus : NULL,
+    };
+    struct sched_task status_sched = {.name = "status", .fn = status_task, .arg = &status, .period_ns = STATUS_PERIOD_NS};
 
-        print_sensor_data(bmp280_temp, bmp280_pressure, &temperature, &humidity);
+    if (acq && (scheduler_init(&sched, 1) < 0 || scheduler_attach(&sched, &loop) < 0))
+    {
+        fprintf(stderr, "Failed to set up the status task\n");
+    }
+    else if (acq)
+    {
+        if (verbose)
+            scheduler_add(&sched, &status_sched, WELCOME_NS + STATUS_PERIOD_NS);
 
-        sleep(5); // Wait 5 seconds between measurements
+        // Display refresh and signals, until SIGINT/SIGTERM
+        event_loop_run(&loop);
     }
 
     // Cleanup before exiting
     if (verbose)
         printf("Cleaning up resources...\n");
-    i2c_close(i2c_bus);
+    acquisition_stop(acq);
 
-    bmp280_close(bmp280_sens);
-    htu21d_close(htu21d_sens);
+    // Drains the rings: every acquired sample is stored and the last one shown
+    if (pipeline)
+    {
+        struct pipeline_stats stats;
+        pipeline_stop(pipeline, &stats);
 
+        if (verbose || stats.storage_dropped || stats.store_errors)
+            printf("Pipeline: %llu samples queued for storage, %llu dropped, %llu store errors\n",
+                   (unsigned long long)stats.storage_pushed, (unsigned long long)stats.storage_dropped,
+                   (unsigned long long)stats.store_errors);
+    }
+
+    // Commits the samples still buffered
     sensors_db_close(sens_db);
+    sensors_history_destroy(history);
+
+    display_clear(display);
+    display_destroy(display);
 
-    display_clear();
-    display_destroy();
+    scheduler_destroy(&sched);
+    event_loop_remove(&loop, &signal_src);
+    event_loop_destroy(&loop);
+
+    // Last: the bus-owner threads serve the display and sensors until here
+    device_registry_close(&registry);
+
+    if (registry.capture)
+    {
+        if (verbose)
+            printf("I2C capture: %llu transfers\n", (unsigned long long)registry.capture->transfers);
+        i2c_capture_log_close(registry.capture);
+    }
 
     if (verbose)
         printf("Program terminated.\n");
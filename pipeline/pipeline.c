@@ -0,0 +1,174 @@
+#include "pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static void *pipeline_storage_thread(void *arg)
+{
+    struct pipeline *self = (struct pipeline *)arg;
+    struct sensors_sample batch[PIPELINE_STORAGE_BATCH];
+    size_t n;
+
+    for (;;)
+    {
+        // Nothing coming in: the open batch may still be due for a commit
+        if (!spsc_ring_wait_ms(&self->storage_ring, PIPELINE_FLUSH_CHECK_MS))
+        {
+            sensors_db_flush_due(self->db);
+            continue;
+        }
+
+        // Read before draining: everything pushed before the stop is drained below
+        bool stopping = !atomic_load(&self->running);
+
+        while ((n = spsc_ring_pop(&self->storage_ring, batch, PIPELINE_STORAGE_BATCH)) > 0)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                if (self->history)
+                    sensors_history_add(self->history, &batch[i]);
+
+                if (sensors_db_store_sample(self->db, &batch[i]) == 0)
+                {
+                    atomic_fetch_add_explicit(&self->stored, 1, memory_order_relaxed);
+                    if (self->verbose)
+                        printf("Sensors data stored successfully\n");
+                }
+                else
+                {
+                    atomic_fetch_add_explicit(&self->store_errors, 1, memory_order_relaxed);
+                }
+            }
+        }
+
+        if (stopping)
+            break;
+    }
+
+    return NULL;
+}
+
+static void *pipeline_presentation_thread(void *arg)
+{
+    struct pipeline *self = (struct pipeline *)arg;
+    struct sensor_snapshot snap;
+    uint64_t last_seq = 0;
+
+    for (;;)
+    {
+        while (sem_wait(&self->published) < 0)
+            ; // EINTR
+
+        // Publications made meanwhile: the snapshot only holds the newest
+        while (sem_trywait(&self->published) == 0)
+            ;
+
+        bool stopping = !atomic_load(&self->running);
+
+        if (sensor_snapshot_read_newer(self->latest, &last_seq, &snap))
+        {
+            if (self->present)
+                self->present(&snap.sample, self->present_arg);
+            atomic_fetch_add_explicit(&self->presented, 1, memory_order_relaxed);
+        }
+
+        if (stopping)
+            break;
+    }
+
+    return NULL;
+}
+
+struct pipeline *pipeline_start(struct sensors_db *db, struct sensors_history *history, struct sensor_snapshot_cell *latest,
+                                pipeline_present_cb present, void *present_arg, int verbose)
+{
+    if (!latest)
+        return NULL;
+
+    struct pipeline *self = (struct pipeline *)calloc(1, sizeof(struct pipeline));
+
+    if (!self)
+        return NULL;
+
+    self->db = db;
+    self->history = history;
+    self->latest = latest;
+    self->present = present;
+    self->present_arg = present_arg;
+    self->verbose = verbose;
+    atomic_store(&self->running, true);
+
+    if (spsc_ring_init(&self->storage_ring, PIPELINE_STORAGE_RING, sizeof(struct sensors_sample)) < 0)
+        goto err_free;
+
+    if (sem_init(&self->published, 0, 0) < 0)
+        goto err_storage_ring;
+
+    if (pthread_create(&self->storage_thread, NULL, pipeline_storage_thread, self) != 0)
+    {
+        perror("Failed to start storage thread");
+        goto err_published;
+    }
+
+    if (pthread_create(&self->presentation_thread, NULL, pipeline_presentation_thread, self) != 0)
+    {
+        perror("Failed to start presentation thread");
+        atomic_store(&self->running, false);
+        spsc_ring_wake(&self->storage_ring);
+        pthread_join(self->storage_thread, NULL);
+        goto err_published;
+    }
+
+    return self;
+
+err_published:
+    sem_destroy(&self->published);
+err_storage_ring:
+    spsc_ring_destroy(&self->storage_ring);
+err_free:
+    free(self);
+    return NULL;
+}
+
+void pipeline_submit(struct pipeline *self, const struct sensors_sample *fresh, bool published)
+{
+    if (!self || !fresh)
+        return;
+
+    if (published)
+        sem_post(&self->published);
+
+    if (fresh->valid != 0)
+        spsc_ring_push(&self->storage_ring, fresh);
+}
+
+void pipeline_get_stats(struct pipeline *self, struct pipeline_stats *stats)
+{
+    if (!self || !stats)
+        return;
+
+    stats->storage_pushed = atomic_load_explicit(&self->storage_ring.pushed, memory_order_relaxed);
+    stats->storage_dropped = atomic_load_explicit(&self->storage_ring.dropped, memory_order_relaxed);
+    stats->stored = atomic_load_explicit(&self->stored, memory_order_relaxed);
+    stats->store_errors = atomic_load_explicit(&self->store_errors, memory_order_relaxed);
+    stats->presented = atomic_load_explicit(&self->presented, memory_order_relaxed);
+}
+
+void pipeline_stop(struct pipeline *self, struct pipeline_stats *stats)
+{
+    if (!self)
+        return;
+
+    atomic_store(&self->running, false);
+    spsc_ring_wake(&self->storage_ring);
+    sem_post(&self->published);
+
+    pthread_join(self->storage_thread, NULL);
+    pthread_join(self->presentation_thread, NULL);
+
+    if (stats)
+        pipeline_get_stats(self, stats);
+
+    spsc_ring_destroy(&self->storage_ring);
+    sem_destroy(&self->published);
+    free(self);
+}
@@ -0,0 +1,83 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+/*
+    Staged sample pipeline. Acquisition only timestamps samples, pushes
+    them into an SPSC ring and publishes the merged readings to a
+    sensor_snapshot, so a slow commit or display update never delays the
+    next acquisition:
+    - storage stage: drains its ring in batches into the history and the
+      sensors_db (samples with at least one valid channel)
+    - presentation stage: woken on every publication, presents the latest
+      snapshot (publications made while it was busy are skipped)
+    A full ring drops and counts; pipeline_stop() drains whatever is queued.
+*/
+
+#include <pthread.h>
+#include <semaphore.h>
+#include "db.h"
+#include "history.h"
+#include "spsc_ring.h"
+#include "sensor_snapshot.h"
+
+#define PIPELINE_STORAGE_RING 1024 // 15 min at 1 Hz BMP280 + 0.1 Hz HTU21D
+#define PIPELINE_STORAGE_BATCH 64
+#define PIPELINE_FLUSH_CHECK_MS 1000 // idle storage thread: how often to look for overdue batches
+
+// Presentation callback, called from the presentation thread
+typedef void (*pipeline_present_cb)(const struct sensors_sample *sample, void *arg);
+
+struct pipeline_stats
+{
+    uint64_t storage_pushed;
+    uint64_t storage_dropped; // storage ring overflows
+    uint64_t stored;
+    uint64_t store_errors;
+    uint64_t presented;
+};
+
+struct pipeline
+{
+    struct sensors_db *db;
+    struct sensors_history *history;
+    struct sensor_snapshot_cell *latest;
+    pipeline_present_cb present;
+    void *present_arg;
+    int verbose;
+
+    struct spsc_ring storage_ring;
+    sem_t published; // one post per snapshot publication (and per wake)
+
+    _Atomic bool running;
+    _Atomic uint64_t stored;
+    _Atomic uint64_t store_errors;
+    _Atomic uint64_t presented;
+
+    pthread_t storage_thread;
+    pthread_t presentation_thread;
+};
+
+/*
+    Start the storage and presentation threads (`history` and `present` may
+    be NULL). `latest` is the snapshot the presentation stage shows.
+*/
+struct pipeline *pipeline_start(struct sensors_db *db, struct sensors_history *history, struct sensor_snapshot_cell *latest,
+                                pipeline_present_cb present, void *present_arg, int verbose);
+
+/*
+    Single producer, never blocks: acquisition workers on several threads
+    must serialize their calls (see acquisition.h). `fresh` (only the
+    channels just read valid) goes to storage; `published`: the snapshot
+    was just updated, wake the presentation stage.
+*/
+void pipeline_submit(struct pipeline *self, const struct sensors_sample *fresh, bool published);
+
+void pipeline_get_stats(struct pipeline *self, struct pipeline_stats *stats);
+
+/*
+    Drain the storage ring, present the last snapshot, stop the stage threads and free the pipeline (the db
+    is left open). `stats` (may be NULL) gets the final counters.
+*/
+void pipeline_stop(struct pipeline *self, struct pipeline_stats *stats);
+
+#endif /* PIPELINE_H */
@@ -0,0 +1,111 @@
+#include "spsc_ring.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+int spsc_ring_init(struct spsc_ring *ring, size_t capacity, size_t elem_size)
+{
+    if (!ring || capacity == 0 || elem_size == 0)
+        return -1;
+
+    size_t size = 1;
+    while (size < capacity)
+        size *= 2;
+
+    memset(ring, 0, sizeof(*ring));
+
+    ring->slots = (uint8_t *)malloc(size * elem_size);
+    if (!ring->slots)
+        return -1;
+
+    ring->mask = size - 1;
+    ring->elem_size = elem_size;
+
+    if (sem_init(&ring->items, 0, 0) < 0)
+    {
+        free(ring->slots);
+        return -1;
+    }
+
+    return 0;
+}
+
+bool spsc_ring_push(struct spsc_ring *ring, const void *elem)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail > ring->mask)
+    {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    memcpy(ring->slots + (head & ring->mask) * ring->elem_size, elem, ring->elem_size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    atomic_fetch_add_explicit(&ring->pushed, 1, memory_order_relaxed);
+
+    sem_post(&ring->items);
+
+    return true;
+}
+
+size_t spsc_ring_pop(struct spsc_ring *ring, void *out, size_t max)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t n = head - tail;
+
+    if (n > max)
+        n = max;
+
+    for (size_t i = 0; i < n; i++)
+        memcpy((uint8_t *)out + i * ring->elem_size, ring->slots + ((tail + i) & ring->mask) * ring->elem_size, ring->elem_size);
+
+    atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+
+    return n;
+}
+
+void spsc_ring_wait(struct spsc_ring *ring)
+{
+    // Posts left over from elements already drained only cause an empty pass
+    while (sem_wait(&ring->items) < 0)
+        ; // EINTR
+}
+
+bool spsc_ring_wait_ms(struct spsc_ring *ring, int timeout_ms)
+{
+    // sem_timedwait() only takes CLOCK_REALTIME deadlines
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    while (sem_timedwait(&ring->items, &deadline) < 0)
+        if (errno != EINTR) // ETIMEDOUT
+            return false;
+
+    return true;
+}
+
+void spsc_ring_wake(struct spsc_ring *ring)
+{
+    sem_post(&ring->items);
+}
+
+void spsc_ring_destroy(struct spsc_ring *ring)
+{
+    if (!ring)
+        return;
+
+    sem_destroy(&ring->items);
+    free(ring->slots);
+    ring->slots = NULL;
+}
@@ -0,0 +1,51 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+/*
+    Lock-free single-producer/single-consumer ring of fixed-size elements.
+    Pushing never blocks: when the ring is full the element is dropped and
+    counted. The consumer can sleep on the ring until something is pushed.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+
+struct spsc_ring
+{
+    _Alignas(64) _Atomic size_t head; // next slot to write, producer only
+    _Alignas(64) _Atomic size_t tail; // next slot to read, consumer only
+
+    _Alignas(64) uint8_t *slots;
+    size_t mask; // capacity - 1, capacity is a power of two
+    size_t elem_size;
+
+    _Atomic uint64_t pushed;
+    _Atomic uint64_t dropped; // pushes refused because the ring was full
+
+    sem_t items; // one post per push (and per wake)
+};
+
+// `capacity` is rounded up to a power of two; returns 0 or -1
+int spsc_ring_init(struct spsc_ring *ring, size_t capacity, size_t elem_size);
+
+// Producer: false (and counted as dropped) when full
+bool spsc_ring_push(struct spsc_ring *ring, const void *elem);
+
+// Consumer: move up to `max` elements to `out`, oldest first; returns how many
+size_t spsc_ring_pop(struct spsc_ring *ring, void *out, size_t max);
+
+// Consumer: block until something was pushed or spsc_ring_wake() was called
+void spsc_ring_wait(struct spsc_ring *ring);
+
+// Consumer: same, giving up after `timeout_ms`; false on timeout
+bool spsc_ring_wait_ms(struct spsc_ring *ring, int timeout_ms);
+
+// Any thread: wake the consumer up (shutdown)
+void spsc_ring_wake(struct spsc_ring *ring);
+
+void spsc_ring_destroy(struct spsc_ring *ring);
+
+#endif /* SPSC_RING_H */
@@ -0,0 +1,393 @@
+#include "device_registry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "i2c_sim.h"
+#include "bmp280.h"
+#include "htu21d.h"
+#include "display.h"
+
+#define LINE_SIZE 256
+
+static const char *const driver_names[] = {
+    [DEVICE_DRIVER_BMP280] = "bmp280",
+    [DEVICE_DRIVER_HTU21D] = "htu21d",
+    [DEVICE_DRIVER_LCD1602] = "lcd1602",
+};
+
+#define DRIVERS (sizeof(driver_names) / sizeof(driver_names[0]))
+
+const char *device_driver_name(enum device_driver driver)
+{
+    return (size_t)driver < DRIVERS ? driver_names[driver] : "unknown";
+}
+
+static int parse_driver(const char *name, enum device_driver *driver)
+{
+    for (size_t i = 0; i < DRIVERS; i++)
+    {
+        if (strcmp(name, driver_names[i]) == 0)
+        {
+            *driver = (enum device_driver)i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+// Whole string as an integer in [min, max] (decimal or 0x hex)
+static int parse_long(const char *str, long min, long max, long *value)
+{
+    char *end;
+
+    *value = strtol(str, &end, 0);
+    if (end == str || *end != '\0' || *value < min || *value > max)
+        return -1;
+
+    return 0;
+}
+
+// key=value options after the address
+static int parse_option(struct device_config *config, const char *option)
+{
+    long value, channel;
+
+    if (strncmp(option, "mux=", 4) == 0)
+    {
+        char addr[16];
+        const char *colon = strchr(option + 4, ':');
+
+        if (!colon || (size_t)(colon - (option + 4)) >= sizeof(addr))
+            return -1;
+
+        memcpy(addr, option + 4, colon - (option + 4));
+        addr[colon - (option + 4)] = '\0';
+
+        if (parse_long(addr, 0x03, 0x77, &value) < 0 || parse_long(colon + 1, 0, TCA9548A_CHANNELS - 1, &channel) < 0)
+            return -1;
+
+        config->mux_address = (int)value;
+        config->mux_channel = (int)channel;
+        return 0;
+    }
+
+    if (strncmp(option, "period=", 7) == 0)
+    {
+        if (parse_long(option + 7, 1, 24 * 3600 * 1000L, &value) < 0)
+            return -1;
+
+        config->period_ns = value * 1000000LL;
+        return 0;
+    }
+
+    if (strcmp(option, "display=no") == 0 || strcmp(option, "display=yes") == 0)
+    {
+        config->display = option[8] == 'y';
+        return 0;
+    }
+
+    return -1;
+}
+
+// One non-empty line: id name driver bus address [options]
+static int parse_line(char *line, struct device_config *config)
+{
+    char *fields[5];
+    char *save;
+    long value;
+
+    memset(config, 0, sizeof(*config));
+    config->mux_address = -1;
+    config->mux_channel = -1;
+    config->display = true;
+
+    for (int i = 0; i < 5; i++)
+    {
+        fields[i] = strtok_r(i == 0 ? line : NULL, " \t\r\n", &save);
+        if (!fields[i])
+            return -1;
+    }
+
+    if (parse_long(fields[0], 1, UINT16_MAX, &value) < 0)
+        return -1;
+    config->id = (uint16_t)value;
+
+    if (strlen(fields[1]) >= sizeof(config->name) || strlen(fields[3]) >= sizeof(config->bus_path))
+        return -1;
+    strcpy(config->name, fields[1]);
+    strcpy(config->bus_path, fields[3]);
+
+    if (parse_driver(fields[2], &config->driver) < 0)
+        return -1;
+
+    if (parse_long(fields[4], 0x03, 0x77, &value) < 0)
+        return -1;
+    config->address = (uint8_t)value;
+
+    for (char *option; (option = strtok_r(NULL, " \t\r\n", &save));)
+        if (parse_option(config, option) < 0)
+            return -1;
+
+    return 0;
+}
+
+/****************** Public API ******************/
+
+void device_registry_init(struct device_registry *self)
+{
+    if (self)
+        memset(self, 0, sizeof(*self));
+}
+
+int device_registry_add(struct device_registry *self, const struct device_config *config)
+{
+    if (!self || !config || config->id == 0)
+        return -1;
+
+    if (self->count == DEVICE_REGISTRY_MAX_DEVICES)
+    {
+        fprintf(stderr, "Device registry: more than %d devices\n", DEVICE_REGISTRY_MAX_DEVICES);
+        return -1;
+    }
+
+    for (size_t i = 0; i < self->count; i++)
+    {
+        if (self->devices[i].id == config->id)
+        {
+            fprintf(stderr, "Device registry: id %u used twice\n", (unsigned)config->id);
+            return -1;
+        }
+    }
+
+    self->devices[self->count] = *config;
+    self->devices[self->count].i2c_bus = NULL;
+    self->devices[self->count].bus_index = -1;
+    self->count++;
+
+    return 0;
+}
+
+int device_registry_load(struct device_registry *self, const char *path)
+{
+    char line[LINE_SIZE];
+    int line_no = 0;
+    int ret = 0;
+
+    if (!self || !path)
+        return -1;
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror("Failed to open the device config");
+        return -1;
+    }
+
+    while (ret == 0 && fgets(line, sizeof(line), file))
+    {
+        struct device_config config;
+        char *comment = strchr(line, '#');
+
+        line_no++;
+
+        if (comment)
+            *comment = '\0';
+        if (strspn(line, " \t\r\n") == strlen(line))
+            continue;
+
+        if (parse_line(line, &config) < 0)
+        {
+            fprintf(stderr, "%s:%d: invalid device line\n", path, line_no);
+            ret = -1;
+        }
+        else if (device_registry_add(self, &config) < 0)
+        {
+            fprintf(stderr, "%s:%d: device not added\n", path, line_no);
+            ret = -1;
+        }
+    }
+
+    fclose(file);
+
+    if (ret == 0 && self->count == 0)
+    {
+        fprintf(stderr, "%s: no devices\n", path);
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int device_registry_add_defaults(struct device_registry *self, const char *bus_path)
+{
+    static const struct
+    {
+        const char *name;
+        enum device_driver driver;
+        uint8_t address;
+    } defaults[] = {
+        {"bmp280", DEVICE_DRIVER_BMP280, BMP280_DEFAULT_ADDR},
+        {"htu21d", DEVICE_DRIVER_HTU21D, HTU21D_DEFAULT_ADDR},
+        {"lcd", DEVICE_DRIVER_LCD1602, DISPLAY_DEFAULT_ADDR},
+    };
+
+    if (!self || !bus_path || strlen(bus_path) >= DEVICE_BUS_PATH_SIZE)
+        return -1;
+
+    for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++)
+    {
+        struct device_config config = {
+            .id = (uint16_t)(i + 1),
+            .driver = defaults[i].driver,
+            .address = defaults[i].address,
+            .mux_address = -1,
+            .mux_channel = -1,
+            .display = true,
+        };
+
+        strcpy(config.name, defaults[i].name);
+        strcpy(config.bus_path, bus_path);
+
+        if (device_registry_add(self, &config) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+// Index of the physical bus `path`, opened on first use (-1 on failure)
+static int device_registry_bus(struct device_registry *self, const char *path, bool simulate)
+{
+    for (size_t i = 0; i < self->bus_count; i++)
+        if (strcmp(self->buses[i].path, path) == 0)
+            return (int)i;
+
+    if (self->bus_count == DEVICE_REGISTRY_MAX_BUSES)
+    {
+        fprintf(stderr, "Device registry: more than %d buses\n", DEVICE_REGISTRY_MAX_BUSES);
+        return -1;
+    }
+
+    struct device_registry_bus *bus = &self->buses[self->bus_count];
+
+    // Each configured bus gets its own simulated devices
+    strcpy(bus->path, path);
+    if (self->capture)
+        bus->i2c_bus = i2c_capture_init(self->capture, bus->path, simulate ? I2C_SIM_PATH : bus->path);
+    else
+        bus->i2c_bus = i2c_init(simulate ? I2C_SIM_PATH : bus->path);
+    if (!bus->i2c_bus)
+    {
+        fprintf(stderr, "Failed to initialize I2C bus %s\n", path);
+        return -1;
+    }
+
+    return (int)self->bus_count++;
+}
+
+// Channel bus of the mux at `address` on bus `bus_index`, both opened on first use
+static struct I2cBus *device_registry_mux_channel(struct device_registry *self, int bus_index, uint8_t address, int channel)
+{
+    struct device_registry_mux *mux = NULL;
+
+    for (size_t i = 0; i < self->mux_count && !mux; i++)
+        if (self->muxes[i].bus_index == bus_index && self->muxes[i].address == address)
+            mux = &self->muxes[i];
+
+    if (!mux)
+    {
+        if (self->mux_count == DEVICE_REGISTRY_MAX_MUXES)
+        {
+            fprintf(stderr, "Device registry: more than %d muxes\n", DEVICE_REGISTRY_MAX_MUXES);
+            return NULL;
+        }
+
+        mux = &self->muxes[self->mux_count];
+        memset(mux, 0, sizeof(*mux));
+        mux->bus_index = bus_index;
+        mux->address = address;
+        mux->mux = i2c_mux_create(self->buses[bus_index].i2c_bus, address);
+        if (!mux->mux)
+            return NULL;
+
+        self->mux_count++;
+    }
+
+    if (!mux->channels[channel])
+        mux->channels[channel] = i2c_mux_channel(mux->mux, (uint8_t)channel);
+
+    return mux->channels[channel];
+}
+
+int device_registry_open(struct device_registry *self, bool simulate)
+{
+    if (!self)
+        return -1;
+
+    for (size_t i = 0; i < self->count; i++)
+    {
+        struct device_config *config = &self->devices[i];
+
+        config->bus_index = device_registry_bus(self, config->bus_path, simulate);
+        if (config->bus_index < 0)
+            goto err_close;
+
+        if (config->mux_address < 0)
+            config->i2c_bus = self->buses[config->bus_index].i2c_bus;
+        else
+            config->i2c_bus = device_registry_mux_channel(self, config->bus_index, (uint8_t)config->mux_address,
+                                                          config->mux_channel);
+
+        if (!config->i2c_bus)
+        {
+            fprintf(stderr, "Failed to open the bus of device %u (%s)\n", (unsigned)config->id, config->name);
+            goto err_close;
+        }
+    }
+
+    return 0;
+
+err_close:
+    device_registry_close(self);
+    return -1;
+}
+
+void device_registry_close(struct device_registry *self)
+{
+    if (!self)
+        return;
+
+    // Channels before their mux, muxes before the parent bus
+    for (size_t i = 0; i < self->mux_count; i++)
+    {
+        for (int ch = 0; ch < TCA9548A_CHANNELS; ch++)
+            if (self->muxes[i].channels[ch])
+                i2c_close(self->muxes[i].channels[ch]);
+
+        i2c_mux_destroy(self->muxes[i].mux);
+    }
+    self->mux_count = 0;
+
+    for (size_t i = 0; i < self->bus_count; i++)
+        i2c_close(self->buses[i].i2c_bus);
+    self->bus_count = 0;
+
+    for (size_t i = 0; i < self->count; i++)
+    {
+        self->devices[i].i2c_bus = NULL;
+        self->devices[i].bus_index = -1;
+    }
+}
+
+struct device_config *device_registry_find(struct device_registry *self, enum device_driver driver)
+{
+    if (!self)
+        return NULL;
+
+    for (size_t i = 0; i < self->count; i++)
+        if (self->devices[i].driver == driver)
+            return &self->devices[i];
+
+    return NULL;
+}
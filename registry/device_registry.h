@@ -0,0 +1,114 @@
+#ifndef DEVICE_REGISTRY_H
+#define DEVICE_REGISTRY_H
+
+/*
+    Devices of the station, loaded from a config file instead of being
+    wired in main(): which driver runs at which address, on which bus, and
+    optionally behind which TCA9548A channel. One device per line:
+
+        # id  name     driver  bus         address  [options]
+        1     indoor   bmp280  /dev/i2c-1  0x76
+        2     outdoor  htu21d  /dev/i2c-1  0x40     mux=0x70:2 period=30000
+        3     lcd      lcd1602 /dev/i2c-1  0x27
+
+    - id: 1-65535, unique, stored with every sample (sensors_sample.device)
+    - driver: bmp280, htu21d or lcd1602
+    - mux=ADDR:CH: behind channel CH (0-7) of the mux at ADDR
+    - period=MS: sampling period, default 1 s (bmp280) / 10 s (htu21d)
+    - display=no: stored but not merged into the readings shown
+    Everything after '#' is a comment.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "i2c.h"
+#include "i2c_mux.h"
+#include "i2c_capture.h"
+
+#define DEVICE_REGISTRY_MAX_DEVICES 16
+#define DEVICE_REGISTRY_MAX_BUSES 4
+#define DEVICE_REGISTRY_MAX_MUXES 4
+#define DEVICE_NAME_SIZE 32
+#define DEVICE_BUS_PATH_SIZE 64
+
+enum device_driver
+{
+    DEVICE_DRIVER_BMP280,
+    DEVICE_DRIVER_HTU21D,
+    DEVICE_DRIVER_LCD1602,
+};
+
+struct device_config
+{
+    uint16_t id;
+    char name[DEVICE_NAME_SIZE];
+    enum device_driver driver;
+    char bus_path[DEVICE_BUS_PATH_SIZE];
+    uint8_t address;
+    int mux_address; // -1: directly on the bus
+    int mux_channel;
+    int64_t period_ns; // 0: driver default
+    bool display;
+
+    // Set by device_registry_open()
+    struct I2cBus *i2c_bus; // what the driver talks to: the bus, or the mux channel
+    int bus_index;          // physical bus, index in device_registry.buses
+};
+
+struct device_registry_bus
+{
+    char path[DEVICE_BUS_PATH_SIZE];
+    struct I2cBus *i2c_bus;
+};
+
+struct device_registry_mux
+{
+    int bus_index;
+    uint8_t address;
+    struct i2c_mux *mux;
+    struct I2cBus *channels[TCA9548A_CHANNELS]; // opened on first use
+};
+
+struct device_registry
+{
+    struct device_config devices[DEVICE_REGISTRY_MAX_DEVICES];
+    size_t count;
+
+    struct device_registry_bus buses[DEVICE_REGISTRY_MAX_BUSES];
+    size_t bus_count;
+
+    struct device_registry_mux muxes[DEVICE_REGISTRY_MAX_MUXES];
+    size_t mux_count;
+
+    // Set before device_registry_open() to log every transaction of the buses (NULL: off)
+    struct i2c_capture_log *capture;
+};
+
+void device_registry_init(struct device_registry *self);
+
+// Add one device (id and capacity checked), returns 0 or -1
+int device_registry_add(struct device_registry *self, const struct device_config *config);
+
+// Parse `path` (see above), returns 0 or -1 with the offending line reported
+int device_registry_load(struct device_registry *self, const char *path);
+
+// The original station: bmp280 (1) at 0x76, htu21d (2) at 0x40, lcd1602 (3) at 0x27 on `bus_path`
+int device_registry_add_defaults(struct device_registry *self, const char *bus_path);
+
+/*
+    Open every bus once (the simulated one instead when `simulate`), then
+    the muxes and their channels, and point each device at its I2cBus.
+    Returns 0 or -1 (what was opened is closed again).
+*/
+int device_registry_open(struct device_registry *self, bool simulate);
+
+// Close the mux channels, the muxes and the buses (drivers first)
+void device_registry_close(struct device_registry *self);
+
+// First device with `driver`, NULL if none
+struct device_config *device_registry_find(struct device_registry *self, enum device_driver driver);
+
+const char *device_driver_name(enum device_driver driver);
+
+#endif /* DEVICE_REGISTRY_H */
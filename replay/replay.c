@@ -0,0 +1,357 @@
+#include "replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "bmp280.h"
+#include "htu21d.h"
+#include "i2c_capture.h"
+
+#define NSEC_PER_SEC 1000000000LL
+#define I2C_ADDRESSES 128
+
+struct replay_device
+{
+    const struct device_config *config;
+
+    // BMP280
+    bmp280_calib_data calib;
+    bool calibrated;
+
+    // HTU21D: channel of the last trigger command, temperature waiting for its humidity
+    enum htu21d_channel channel;
+    bool triggered;
+    struct htu21d_measurement temperature;
+};
+
+struct replay
+{
+    const struct device_registry *registry;
+    struct sensors_db *db;
+    struct sensors_history *history;
+    struct replay_stats *stats;
+    int64_t start_ms; // Unix time of the first transfer
+
+    struct replay_device devices[DEVICE_REGISTRY_MAX_DEVICES];
+
+    // TCA9548A control registers as last written, per captured bus
+    uint8_t mux_control[I2C_CAPTURE_MAX_BUSES][I2C_ADDRESSES];
+};
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void stage_add(struct replay_stats *stats, enum replay_stage_id stage, int64_t ns)
+{
+    struct replay_stage *s = &stats->stages[stage];
+
+    s->count++;
+    s->total_ns += ns;
+    if (ns > s->max_ns)
+        s->max_ns = ns;
+}
+
+// True if `addr` is the mux of some device on this bus
+static bool replay_is_mux(struct replay *self, const struct i2c_capture_xfer *xfer, uint8_t addr)
+{
+    for (size_t i = 0; i < self->registry->count; i++)
+    {
+        const struct device_config *config = &self->registry->devices[i];
+
+        if (config->mux_address == addr && strcmp(config->bus_path, xfer->bus_name) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+// Device the transfer talks to, given the mux channels selected at that point
+static struct replay_device *replay_device(struct replay *self, const struct i2c_capture_xfer *xfer)
+{
+    uint8_t addr = xfer->msgs[0].addr;
+
+    for (size_t i = 0; i < self->registry->count; i++)
+    {
+        const struct device_config *config = &self->registry->devices[i];
+
+        if (config->address != addr || strcmp(config->bus_path, xfer->bus_name) != 0)
+            continue;
+
+        if (config->mux_address >= 0 && !(self->mux_control[xfer->bus][config->mux_address] & (1u << config->mux_channel)))
+            continue;
+
+        return &self->devices[i];
+    }
+
+    return NULL;
+}
+
+// Storage path of one decoded sample, `decode_start` (ns) is when its bytes were picked up
+static void replay_store(struct replay *self, struct replay_device *dev, struct sensors_sample *sample,
+                         const struct i2c_capture_xfer *xfer, int64_t decode_start)
+{
+    int64_t t;
+
+    sample->timestamp_ms = self->start_ms + (int64_t)(xfer->t_ns / 1000000);
+    sample->device = dev->config->id;
+
+    t = now_ns();
+    stage_add(self->stats, REPLAY_STAGE_DECODE, t - decode_start);
+
+    // Same rule as the pipeline: nothing valid, nothing stored
+    if (sample->valid == 0)
+        return;
+
+    if (self->history)
+    {
+        sensors_history_add(self->history, sample);
+        int64_t h = now_ns();
+        stage_add(self->stats, REPLAY_STAGE_HISTORY, h - t);
+        t = h;
+    }
+
+    sensors_db_store_sample(self->db, sample);
+    stage_add(self->stats, REPLAY_STAGE_STORE, now_ns() - t);
+
+    self->stats->samples++;
+}
+
+// Register burst reads: calibration (kept) and data (compensated, stored)
+static void replay_bmp280(struct replay *self, struct replay_device *dev, const struct i2c_capture_xfer *xfer)
+{
+    int64_t start = now_ns();
+
+    if (xfer->count != 2 || xfer->msgs[0].read || xfer->msgs[0].len != 1 || !xfer->msgs[1].read)
+        return;
+
+    uint8_t reg = xfer->msgs[0].data[0];
+    const struct i2c_capture_msg *data = &xfer->msgs[1];
+
+    if (reg == BMP280_REG_CALIB && data->len >= BMP280_CALIB_SIZE)
+    {
+        bmp280_parse_calibration(data->data, &dev->calib);
+        dev->calibrated = true;
+        return;
+    }
+
+    if (reg != BMP280_REG_DATA || data->len != BMP280_DATA_SIZE)
+        return;
+
+    if (!dev->calibrated)
+    {
+        self->stats->uncalibrated++;
+        return;
+    }
+
+    struct sensors_sample sample = {0};
+    int32_t temp_centi;
+    uint32_t press_q8;
+
+    bmp280_parse_raw(data->data, &sample.bmp280_adc_T, &sample.bmp280_adc_P);
+    bmp280_compensate_batch(&dev->calib, &sample.bmp280_adc_T, &sample.bmp280_adc_P, &temp_centi, &press_q8, 1);
+    sample.values[0] = temp_centi / 100.0f;
+    sample.values[1] = press_q8 / 25600.0f; // Q24.8 Pa to hPa
+    sample.valid = SENSORS_SAMPLE_BMP280;
+
+    replay_store(self, dev, &sample, xfer, start);
+}
+
+// Trigger commands, then results (no-hold read or hold write+read); humidity closes a sample
+static void replay_htu21d(struct replay *self, struct replay_device *dev, const struct i2c_capture_xfer *xfer)
+{
+    int64_t start = now_ns();
+    const struct i2c_capture_msg *result = NULL;
+    enum htu21d_channel channel;
+
+    if (xfer->count >= 1 && !xfer->msgs[0].read && xfer->msgs[0].len == 1)
+    {
+        if (htu21d_command_channel(xfer->msgs[0].data[0], &channel) < 0)
+            return;
+
+        dev->channel = channel;
+        dev->triggered = true;
+
+        if (xfer->count == 2 && xfer->msgs[1].read)
+            result = &xfer->msgs[1];
+    }
+    else if (xfer->count == 1 && xfer->msgs[0].read)
+    {
+        result = &xfer->msgs[0];
+    }
+
+    if (!result || result->len != HTU21D_RESULT_SIZE || !dev->triggered)
+        return;
+
+    struct htu21d_measurement res;
+    if (htu21d_decode(result->data, dev->channel, &res) < 0)
+        self->stats->crc_errors++;
+
+    dev->triggered = false;
+
+    if (dev->channel == HTU21D_TEMPERATURE)
+    {
+        dev->temperature = res;
+        return;
+    }
+
+    struct sensors_sample sample = {0};
+
+    if (dev->temperature.is_valid)
+    {
+        sample.values[2] = dev->temperature.value;
+        sample.htu21d_raw_temp = dev->temperature.raw;
+        sample.valid |= SENSORS_SAMPLE_HTU21D_TEMP;
+    }
+
+    if (res.is_valid)
+    {
+        sample.values[3] = res.value;
+        sample.htu21d_raw_humidity = res.raw;
+        sample.valid |= SENSORS_SAMPLE_HTU21D_HUMIDITY;
+    }
+
+    dev->temperature = (struct htu21d_measurement){0};
+
+    replay_store(self, dev, &sample, xfer, start);
+}
+
+static void replay_transfer(struct replay *self, const struct i2c_capture_xfer *xfer)
+{
+    self->stats->transfers++;
+
+    if (xfer->status != 0)
+    {
+        self->stats->failed++;
+        return;
+    }
+
+    if (xfer->count == 0)
+        return;
+
+    const struct i2c_capture_msg *first = &xfer->msgs[0];
+
+    // Channel selection: a single control byte written to a mux
+    if (xfer->count == 1 && !first->read && first->len == 1 && first->addr < I2C_ADDRESSES && replay_is_mux(self, xfer, first->addr))
+    {
+        self->mux_control[xfer->bus][first->addr] = first->data[0];
+        return;
+    }
+
+    struct replay_device *dev = replay_device(self, xfer);
+    if (!dev)
+    {
+        self->stats->unmatched++;
+        return;
+    }
+
+    switch (dev->config->driver)
+    {
+    case DEVICE_DRIVER_BMP280:
+        replay_bmp280(self, dev, xfer);
+        break;
+    case DEVICE_DRIVER_HTU21D:
+        replay_htu21d(self, dev, xfer);
+        break;
+    default:
+        break; // display output: nothing to decode
+    }
+}
+
+int replay_run(const struct device_registry *registry, const char *path, double speed, struct sensors_db *db,
+               struct sensors_history *history, struct replay_stats *stats)
+{
+    struct i2c_capture_xfer xfer;
+    int64_t start = 0;
+    uint64_t first_ns = 0;
+    int ret;
+
+    if (!registry || !path || !db || !stats || speed < 0)
+        return -1;
+
+    struct i2c_capture_reader *reader = i2c_capture_reader_open(path);
+    if (!reader)
+        return -1;
+
+    struct replay *self = (struct replay *)calloc(1, sizeof(struct replay));
+    if (!self)
+    {
+        i2c_capture_reader_close(reader);
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    self->registry = registry;
+    self->db = db;
+    self->history = history;
+    self->stats = stats;
+    self->start_ms = sensors_db_now_ms();
+    for (size_t i = 0; i < registry->count; i++)
+        self->devices[i].config = &registry->devices[i];
+
+    while ((ret = i2c_capture_read(reader, &xfer)) > 0)
+    {
+        if (stats->transfers == 0)
+        {
+            start = now_ns();
+            first_ns = xfer.t_ns;
+            self->start_ms -= (int64_t)(first_ns / 1000000);
+        }
+
+        // Paced on absolute deadlines from the first transfer
+        if (speed > REPLAY_SPEED_MAX)
+        {
+            int64_t due = start + (int64_t)((double)(xfer.t_ns - first_ns) / speed);
+            struct timespec ts = {.tv_sec = due / NSEC_PER_SEC, .tv_nsec = due % NSEC_PER_SEC};
+
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+                ;
+        }
+
+        replay_transfer(self, &xfer);
+    }
+
+    stats->truncated = ret < 0;
+
+    int64_t t = now_ns();
+    sensors_db_flush(db);
+    stats->flush_ns = now_ns() - t;
+    stats->elapsed_ns = stats->transfers ? now_ns() - start : 0;
+
+    free(self);
+    i2c_capture_reader_close(reader);
+
+    return 0;
+}
+
+void replay_print_stats(const struct replay_stats *stats)
+{
+    static const char *const stage_names[REPLAY_STAGE_COUNT] = {"decode", "history", "store"};
+    double seconds = stats->elapsed_ns / 1e9;
+
+    printf("Replay: %llu transfers, %llu samples in %.3f s (%.0f samples/s)\n", (unsigned long long)stats->transfers,
+           (unsigned long long)stats->samples, seconds, seconds > 0 ? stats->samples / seconds : 0.0);
+    printf("Skipped: %llu failed transfers, %llu unmatched, %llu CRC errors, %llu uncalibrated\n",
+           (unsigned long long)stats->failed, (unsigned long long)stats->unmatched, (unsigned long long)stats->crc_errors,
+           (unsigned long long)stats->uncalibrated);
+
+    for (int i = 0; i < REPLAY_STAGE_COUNT; i++)
+    {
+        const struct replay_stage *s = &stats->stages[i];
+
+        if (s->count == 0)
+            continue;
+
+        printf("Stage %s: %llu runs, mean %.2f us, max %.2f us\n", stage_names[i], (unsigned long long)s->count,
+               s->total_ns / 1e3 / s->count, s->max_ns / 1e3);
+    }
+
+    printf("Final flush: %.3f ms\n", stats->flush_ns / 1e6);
+
+    if (stats->truncated)
+        fprintf(stderr, "Replay: the capture ends in the middle of a record\n");
+}
@@ -0,0 +1,68 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+/*
+    Replay of an I2C capture (see i2c_capture.h) through the real decode
+    and storage paths, to reproduce field issues and benchmark every
+    change to the drivers and the store on the same bytes:
+    - transactions are matched to the registry's devices by bus, address
+      and, behind a TCA9548A, the channel selected at that point
+    - BMP280 calibration and data bursts go through bmp280_parse_*() and
+      the compensation, HTU21D results through htu21d_decode() (CRC check
+      included), into the same sensors_sample as the live acquisition
+    - then into the history and the sensors_db
+    The stages run inline on the calling thread, so that no sample is
+    dropped however fast the replay goes and each stage can be timed.
+    Samples are timestamped from the replay start at the capture's pace,
+    whatever the speed, so rollups see the original sampling periods.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "db.h"
+#include "history.h"
+#include "device_registry.h"
+
+#define REPLAY_SPEED_MAX 0.0 // no pacing at all
+
+enum replay_stage_id
+{
+    REPLAY_STAGE_DECODE = 0, // parse, CRC, compensation
+    REPLAY_STAGE_HISTORY,
+    REPLAY_STAGE_STORE,      // sensors_db_store_sample(), batched commits included
+    REPLAY_STAGE_COUNT
+};
+
+struct replay_stage
+{
+    uint64_t count;
+    int64_t total_ns;
+    int64_t max_ns;
+};
+
+struct replay_stats
+{
+    uint64_t transfers;
+    uint64_t failed;      // captured with an error status (NACKed polls included)
+    uint64_t unmatched;   // no device of the registry at that address
+    uint64_t crc_errors;
+    uint64_t uncalibrated; // BMP280 data read before its calibration was captured
+    uint64_t samples;      // handed to the storage path
+    bool truncated;        // the log ends in the middle of a record
+
+    int64_t elapsed_ns; // first transfer to the end of the final flush
+    int64_t flush_ns;
+    struct replay_stage stages[REPLAY_STAGE_COUNT];
+};
+
+/*
+    Replay `path` at `speed` times the captured pace (REPLAY_SPEED_MAX: as
+    fast as possible). `history` may be NULL. Returns 0 with `stats`
+    filled, -1 if the log cannot be read.
+*/
+int replay_run(const struct device_registry *registry, const char *path, double speed, struct sensors_db *db,
+               struct sensors_history *history, struct replay_stats *stats);
+
+void replay_print_stats(const struct replay_stats *stats);
+
+#endif /* REPLAY_H */
@@ -0,0 +1,200 @@
+#include "scheduler.h"
+#include <stdlib.h>
+
+#define NSEC_PER_SEC 1000000000LL
+
+static int64_t ts_to_ns(const struct timespec *ts)
+{
+    return (int64_t)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static struct timespec ns_to_ts(int64_t ns)
+{
+    struct timespec ts = {.tv_sec = ns / NSEC_PER_SEC, .tv_nsec = ns % NSEC_PER_SEC};
+    return ts;
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts_to_ns(&ts);
+}
+
+/****************** Min-heap on `next` ******************/
+
+static int task_before(const struct sched_task *a, const struct sched_task *b)
+{
+    return ts_to_ns(&a->next) < ts_to_ns(&b->next);
+}
+
+static void heap_swap(struct scheduler *self, size_t i, size_t j)
+{
+    struct sched_task *tmp = self->heap[i];
+    self->heap[i] = self->heap[j];
+    self->heap[j] = tmp;
+}
+
+static void heap_up(struct scheduler *self, size_t i)
+{
+    while (i > 0 && task_before(self->heap[i], self->heap[(i - 1) / 2]))
+    {
+        heap_swap(self, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void heap_down(struct scheduler *self, size_t i)
+{
+    for (;;)
+    {
+        size_t first = i;
+        size_t l = 2 * i + 1, r = 2 * i + 2;
+
+        if (l < self->count && task_before(self->heap[l], self->heap[first]))
+            first = l;
+        if (r < self->count && task_before(self->heap[r], self->heap[first]))
+            first = r;
+        if (first == i)
+            return;
+
+        heap_swap(self, i, first);
+        i = first;
+    }
+}
+
+// Keep the loop timer on the earliest deadline
+static void scheduler_rearm(struct scheduler *self)
+{
+    if (!self->loop)
+        return;
+
+    if (self->count > 0)
+        event_timer_arm_at(&self->timer, &self->heap[0]->next, 0);
+    else
+        event_timer_disarm(&self->timer);
+}
+
+static void scheduler_event(struct event_source *src, uint32_t events)
+{
+    struct scheduler *self = (struct scheduler *)src->arg;
+
+    (void)events;
+
+    scheduler_run_due(self);
+    scheduler_rearm(self);
+}
+
+/****************** Public API ******************/
+
+int scheduler_init(struct scheduler *self, size_t max_tasks)
+{
+    if (!self || max_tasks == 0)
+        return -1;
+
+    self->heap = (struct sched_task **)calloc(max_tasks, sizeof(struct sched_task *));
+    if (!self->heap)
+        return -1;
+
+    self->count = 0;
+    self->size = max_tasks;
+    self->loop = NULL;
+
+    return 0;
+}
+
+int scheduler_add(struct scheduler *self, struct sched_task *task, int64_t offset_ns)
+{
+    if (!self || !task || !task->fn || task->period_ns <= 0 || self->count == self->size)
+        return -1;
+
+    task->next = ns_to_ts(now_ns() + offset_ns);
+    task->runs = 0;
+    task->missed = 0;
+    task->max_late_ns = 0;
+
+    self->heap[self->count] = task;
+    heap_up(self, self->count++);
+    scheduler_rearm(self);
+
+    return 0;
+}
+
+int scheduler_next_deadline(struct scheduler *self, struct timespec *deadline)
+{
+    if (!self || self->count == 0)
+        return -1;
+
+    *deadline = self->heap[0]->next;
+    return 0;
+}
+
+int scheduler_run_due(struct scheduler *self)
+{
+    int ran = 0;
+
+    while (self->count > 0)
+    {
+        struct sched_task *task = self->heap[0];
+        int64_t deadline = ts_to_ns(&task->next);
+        int64_t late = now_ns() - deadline;
+
+        if (late < 0)
+            break;
+
+        if (late > task->max_late_ns)
+            task->max_late_ns = late;
+
+        struct timespec due = task->next;
+        task->fn(task, &due);
+        task->runs++;
+        ran++;
+
+        // Next deadline on the original grid; skip (and count) the ones already gone
+        int64_t next = deadline + task->period_ns;
+        int64_t now = now_ns();
+        if (next <= now)
+        {
+            int64_t skipped = (now - next) / task->period_ns + 1;
+            task->missed += skipped;
+            next += skipped * task->period_ns;
+        }
+
+        task->next = ns_to_ts(next);
+        heap_down(self, 0);
+    }
+
+    return ran;
+}
+
+int scheduler_attach(struct scheduler *self, struct event_loop *loop)
+{
+    if (!self || !loop || self->loop)
+        return -1;
+
+    self->timer.cb = scheduler_event;
+    self->timer.arg = self;
+    if (event_loop_add_timer(loop, &self->timer) < 0)
+        return -1;
+
+    self->loop = loop;
+    scheduler_rearm(self);
+
+    return 0;
+}
+
+void scheduler_destroy(struct scheduler *self)
+{
+    if (!self)
+        return;
+
+    if (self->loop)
+    {
+        event_loop_remove(self->loop, &self->timer);
+        self->loop = NULL;
+    }
+
+    free(self->heap);
+    self->heap = NULL;
+    self->count = 0;
+}
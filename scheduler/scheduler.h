@@ -0,0 +1,75 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+/*
+    Periodic tasks on absolute CLOCK_MONOTONIC deadlines: a task due at
+    `next` runs, then `next += period`, so the period never accumulates the
+    run time (no drift). The earliest deadline is kept at the top of a
+    min-heap, with a timerfd of the event loop the scheduler is attached to
+    armed on it: no busy waiting, no thread of its own.
+    A task that falls more than a period behind skips the missed runs
+    (counted) instead of running back to back.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "event_loop.h"
+
+struct sched_task;
+
+// Task body; `deadline` is the time it was due
+typedef void (*sched_task_fn)(struct sched_task *task, const struct timespec *deadline);
+
+struct sched_task
+{
+    const char *name;
+    sched_task_fn fn;
+    void *arg;
+    int64_t period_ns;
+
+    // Managed by the scheduler
+    struct timespec next;
+    uint64_t runs;
+    uint64_t missed;       // deadlines skipped because a previous run was too late
+    int64_t max_late_ns;   // worst start latency after the deadline
+};
+
+struct scheduler
+{
+    struct sched_task **heap; // heap[0] has the earliest deadline
+    size_t count;
+    size_t size;
+
+    // scheduler_attach(): fires at heap[0]'s deadline
+    struct event_loop *loop;
+    struct event_source timer;
+};
+
+int scheduler_init(struct scheduler *self, size_t max_tasks);
+
+/*
+    Add `task` (fn, arg, period_ns filled in), first due `offset_ns` from now.
+    The task memory must stay valid while it is scheduled.
+*/
+int scheduler_add(struct scheduler *self, struct sched_task *task, int64_t offset_ns);
+
+// Earliest deadline, -1 if no task is scheduled
+int scheduler_next_deadline(struct scheduler *self, struct timespec *deadline);
+
+/*
+    Run every task whose deadline has passed, in deadline order, and
+    reschedule them. Returns how many ran.
+*/
+int scheduler_run_due(struct scheduler *self);
+
+/*
+    Run the tasks from `loop`: a timerfd is kept armed at the earliest
+    deadline and the due tasks run in its callback.
+*/
+int scheduler_attach(struct scheduler *self, struct event_loop *loop);
+
+// Also detaches from the event loop
+void scheduler_destroy(struct scheduler *self);
+
+#endif /* SCHEDULER_H */
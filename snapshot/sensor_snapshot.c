@@ -0,0 +1,73 @@
+#include "sensor_snapshot.h"
+#include <string.h>
+#include <sched.h>
+
+void sensor_snapshot_init(struct sensor_snapshot_cell *cell)
+{
+    atomic_store(&cell->sequence, 0);
+    for (size_t i = 0; i < SENSOR_SNAPSHOT_WORDS; i++)
+        atomic_store(&cell->words[i], 0);
+}
+
+void sensor_snapshot_publish(struct sensor_snapshot_cell *cell, struct sensor_snapshot *snap)
+{
+    uint64_t words[SENSOR_SNAPSHOT_WORDS] = {0};
+    uint64_t sequence = atomic_load_explicit(&cell->sequence, memory_order_relaxed);
+
+    // Publication n leaves the sequence at 2n
+    snap->seq = sequence / 2 + 1;
+    memcpy(words, snap, sizeof(*snap));
+
+    atomic_store_explicit(&cell->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // odd sequence visible before any word changes
+
+    for (size_t i = 0; i < SENSOR_SNAPSHOT_WORDS; i++)
+        atomic_store_explicit(&cell->words[i], words[i], memory_order_relaxed);
+
+    atomic_store_explicit(&cell->sequence, sequence + 2, memory_order_release);
+}
+
+bool sensor_snapshot_read(struct sensor_snapshot_cell *cell, struct sensor_snapshot *snap)
+{
+    uint64_t words[SENSOR_SNAPSHOT_WORDS];
+    uint64_t before, after;
+
+    for (;;)
+    {
+        before = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        if (before & 1)
+        {
+            // Writer in the middle of a publication (a few stores): let it finish
+            sched_yield();
+            continue;
+        }
+
+        for (size_t i = 0; i < SENSOR_SNAPSHOT_WORDS; i++)
+            words[i] = atomic_load_explicit(&cell->words[i], memory_order_relaxed);
+
+        atomic_thread_fence(memory_order_acquire); // word loads done before re-checking
+        after = atomic_load_explicit(&cell->sequence, memory_order_relaxed);
+
+        if (before == after)
+            break;
+    }
+
+    if (before == 0)
+        return false;
+
+    memcpy(snap, words, sizeof(*snap));
+    return true;
+}
+
+bool sensor_snapshot_read_newer(struct sensor_snapshot_cell *cell, uint64_t *last_seq, struct sensor_snapshot *snap)
+{
+    // Cheap check first: nothing new since the last read
+    if (atomic_load_explicit(&cell->sequence, memory_order_acquire) / 2 <= *last_seq)
+        return false;
+
+    if (!sensor_snapshot_read(cell, snap) || snap->seq <= *last_seq)
+        return false;
+
+    *last_seq = snap->seq;
+    return true;
+}
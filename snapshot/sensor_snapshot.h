@@ -0,0 +1,44 @@
+#ifndef SENSOR_SNAPSHOT_H
+#define SENSOR_SNAPSHOT_H
+
+/*
+    Latest sensor readings, published by the acquisition side through a
+    seqlock: readers never take a lock and never block the writer, they
+    just retry if a publication raced with their copy.
+    Single writer; any number of reader threads.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "db.h"
+
+struct sensor_snapshot
+{
+    uint64_t seq;                  // publication number, starts at 1
+    struct timespec acquired;      // CLOCK_MONOTONIC, end of the acquisition
+    struct sensors_sample sample;  // values, raw words, validity bits (SENSORS_SAMPLE_*), wall clock timestamp
+};
+
+#define SENSOR_SNAPSHOT_WORDS ((sizeof(struct sensor_snapshot) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+struct sensor_snapshot_cell
+{
+    _Atomic uint64_t sequence; // odd while a publication is in progress
+    // The snapshot, copied word by word with relaxed atomics (no torn words, no data race)
+    _Atomic uint64_t words[SENSOR_SNAPSHOT_WORDS];
+};
+
+void sensor_snapshot_init(struct sensor_snapshot_cell *cell);
+
+// Writer: publish `snap` (its seq is set here)
+void sensor_snapshot_publish(struct sensor_snapshot_cell *cell, struct sensor_snapshot *snap);
+
+// Reader: consistent copy of the latest snapshot; returns false if nothing was published yet
+bool sensor_snapshot_read(struct sensor_snapshot_cell *cell, struct sensor_snapshot *snap);
+
+// Reader: same, only if newer than `*last_seq` (updated on success)
+bool sensor_snapshot_read_newer(struct sensor_snapshot_cell *cell, uint64_t *last_seq, struct sensor_snapshot *snap);
+
+#endif /* SENSOR_SNAPSHOT_H */